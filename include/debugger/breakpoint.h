@@ -8,6 +8,7 @@
 #include <debugger/protocol.h>
 #include <debugger/path.h>
 #include <debugger/hashmap.h>
+#include <debugger/stats.h>
 
 struct lua_State;
 namespace lua { struct Debug; }
@@ -68,8 +69,11 @@ namespace vscode
 		breakpointMgr(debugger_impl& dbg);
 		void clear();
 		bool has(bp_source* src, size_t line, debug& debug) const;
-		bp_source* get_function(debug& debug);
+		// `f` is the proto hash of the running function, 0 if unknown.
+		bp_source* get_function(debug& debug, intptr_t f);
 		void       set_breakpoint(source& s, rapidjson::Value const& args, wprotocol& res);
+		void       set_limit(size_t functions);
+		memory_usage function_usage() const;
 
 	private:
 		bp_source& get_source(source& source);
@@ -80,5 +84,6 @@ namespace vscode
 		std::map<intptr_t, bp_source>    memorys_;
 		hashmap<bp_source>               functions_;
 		size_t                           next_id_;
+		size_t                           functionLimit_;
 	};
 }
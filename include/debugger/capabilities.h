@@ -6,6 +6,7 @@ namespace vscode
 {
 	inline void capabilities(wprotocol& res)
 	{
+		const char* conditionDescription = "Stop only when the message contains this pattern ('*' and '?' are wildcards, a leading '!' inverts it)";
 		res("supportsConfigurationDoneRequest").Bool(true);
 		res("supportsSetVariable").Bool(true);
 		res("supportsConditionalBreakpoints").Bool(true);
@@ -16,6 +17,7 @@ namespace vscode
 		res("supportsEvaluateForHovers").Bool(true);
 		res("supportsLoadedSourcesRequest").Bool(true);
 		res("supportsTerminateRequest").Bool(true);
+		res("supportsExceptionFilterOptions").Bool(true);
 		for (auto _ : res("exceptionBreakpointFilters").Array())
 		{
 			for (auto _ : res.Object())
@@ -23,24 +25,32 @@ namespace vscode
 				res("default").Bool(false);
 				res("filter").String("pcall");
 				res("label").String("Exception: Lua pcall");
+				res("supportsCondition").Bool(true);
+				res("conditionDescription").String(conditionDescription);
 			}
 			for (auto _ : res.Object())
 			{
 				res("default").Bool(false);
 				res("filter").String("xpcall");
 				res("label").String("Exception: Lua xpcall");
+				res("supportsCondition").Bool(true);
+				res("conditionDescription").String(conditionDescription);
 			}
 			for (auto _ : res.Object())
 			{
 				res("default").Bool(true);
 				res("filter").String("lua_pcall");
 				res("label").String("Exception: C lua_pcall");
+				res("supportsCondition").Bool(true);
+				res("conditionDescription").String(conditionDescription);
 			}
 			for (auto _ : res.Object())
 			{
 				res("default").Bool(true);
 				res("filter").String("lua_panic");
 				res("label").String("Exception: C lua_panic");
+				res("supportsCondition").Bool(true);
+				res("conditionDescription").String(conditionDescription);
 			}
 		}
 	}
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// Minimal CBOR (RFC 7049) support for the debug protocol. The writer is a
+// rapidjson Handler that emits indefinite-length maps and arrays, so it can
+// be driven by the same streaming calls as rapidjson::Writer. The reader
+// feeds a rapidjson Handler (usually a Document via Populate).
+
+namespace vscode { namespace cbor {
+	enum {
+		major_uint = 0,
+		major_nint = 1,
+		major_bytes = 2,
+		major_text = 3,
+		major_array = 4,
+		major_map = 5,
+		major_tag = 6,
+		major_simple = 7,
+	};
+
+	class writer
+	{
+	public:
+		typedef char Ch;
+
+		writer()
+			: buf_()
+			, level_(0)
+			, written_(false)
+		{ }
+
+		const char* data() const { return buf_.data(); }
+		size_t size() const { return buf_.size(); }
+		bool IsComplete() const { return written_ && level_ == 0; }
+
+		bool Null() { value(); buf_.push_back((char)0xf6); return true; }
+		bool Bool(bool b) { value(); buf_.push_back(b ? (char)0xf5 : (char)0xf4); return true; }
+		bool Int(int i) { return Int64(i); }
+		bool Uint(unsigned u) { return Uint64(u); }
+		bool Int64(int64_t i)
+		{
+			value();
+			if (i < 0) {
+				head(major_nint, (uint64_t)(-(i + 1)));
+			}
+			else {
+				head(major_uint, (uint64_t)i);
+			}
+			return true;
+		}
+		bool Uint64(uint64_t u) { value(); head(major_uint, u); return true; }
+		bool Double(double d)
+		{
+			value();
+			uint64_t v;
+			memcpy(&v, &d, sizeof(v));
+			buf_.push_back((char)0xfb);
+			be(v, 8);
+			return true;
+		}
+		// Integers that fit stay integers; anything else becomes a double.
+		bool RawNumber(const Ch* str, rapidjson::SizeType len, bool copy = false)
+		{
+			std::string s(str, len);
+			if (!s.empty() && s.find_first_of(".eE") == std::string::npos) {
+				char* end = nullptr;
+				errno = 0;
+				if (s[0] == '-') {
+					long long i = strtoll(s.c_str(), &end, 10);
+					if (errno == 0 && end == s.c_str() + s.size()) return Int64(i);
+				}
+				else {
+					unsigned long long u = strtoull(s.c_str(), &end, 10);
+					if (errno == 0 && end == s.c_str() + s.size()) return Uint64(u);
+				}
+			}
+			return Double(strtod(s.c_str(), nullptr));
+		}
+		bool String(const Ch* str, rapidjson::SizeType len, bool copy = false)
+		{
+			value();
+			head(major_text, len);
+			buf_.append(str, len);
+			return true;
+		}
+		bool Key(const Ch* str, rapidjson::SizeType len, bool copy = false)
+		{
+			head(major_text, len);
+			buf_.append(str, len);
+			return true;
+		}
+		bool StartObject() { value(); level_++; buf_.push_back((char)0xbf); return true; }
+		bool EndObject(rapidjson::SizeType = 0) { level_--; buf_.push_back((char)0xff); return true; }
+		bool StartArray() { value(); level_++; buf_.push_back((char)0x9f); return true; }
+		bool EndArray(rapidjson::SizeType = 0) { level_--; buf_.push_back((char)0xff); return true; }
+
+	private:
+		void value()
+		{
+			written_ = true;
+		}
+
+		void be(uint64_t v, int n)
+		{
+			for (int i = n - 1; i >= 0; --i) {
+				buf_.push_back((char)(uint8_t)(v >> (i * 8)));
+			}
+		}
+
+		void head(int major, uint64_t v)
+		{
+			uint8_t m = (uint8_t)(major << 5);
+			if (v < 24) {
+				buf_.push_back((char)(m | v));
+			}
+			else if (v <= 0xff) {
+				buf_.push_back((char)(m | 24));
+				be(v, 1);
+			}
+			else if (v <= 0xffff) {
+				buf_.push_back((char)(m | 25));
+				be(v, 2);
+			}
+			else if (v <= 0xffffffff) {
+				buf_.push_back((char)(m | 26));
+				be(v, 4);
+			}
+			else {
+				buf_.push_back((char)(m | 27));
+				be(v, 8);
+			}
+		}
+
+	private:
+		std::string buf_;
+		int         level_;
+		bool        written_;
+	};
+
+	// A CBOR message always starts with a map; JSON messages start with '{'.
+	inline bool is_cbor(const char* buf, size_t len)
+	{
+		if (len == 0) {
+			return false;
+		}
+		uint8_t c = (uint8_t)buf[0];
+		return (c >> 5) == major_map;
+	}
+
+	template <class Handler>
+	class reader
+	{
+	public:
+		reader(const char* buf, size_t len)
+			: p_((const uint8_t*)buf)
+			, end_((const uint8_t*)buf + len)
+			, ok_(false)
+		{ }
+
+		bool operator()(Handler& h)
+		{
+			ok_ = item(h, 0) && p_ == end_;
+			return ok_;
+		}
+
+		bool ok() const
+		{
+			return ok_;
+		}
+
+	private:
+		enum { max_depth = 128 };
+
+		bool need(size_t n) const
+		{
+			return (size_t)(end_ - p_) >= n;
+		}
+
+		bool be(int n, uint64_t& v)
+		{
+			if (!need(n)) return false;
+			v = 0;
+			for (int i = 0; i < n; ++i) {
+				v = (v << 8) | *p_++;
+			}
+			return true;
+		}
+
+		// Returns false on malformed input; `indefinite` is set for the 0x1f form.
+		bool head(uint8_t ib, uint64_t& v, bool& indefinite)
+		{
+			uint8_t info = ib & 0x1f;
+			indefinite = false;
+			if (info < 24) {
+				v = info;
+				return true;
+			}
+			switch (info) {
+			case 24: return be(1, v);
+			case 25: return be(2, v);
+			case 26: return be(4, v);
+			case 27: return be(8, v);
+			case 31: indefinite = true; return true;
+			default: return false;
+			}
+		}
+
+		bool is_break() const
+		{
+			return p_ < end_ && *p_ == 0xff;
+		}
+
+		bool text(uint64_t len, const char*& s)
+		{
+			if (!need((size_t)len)) return false;
+			s = (const char*)p_;
+			p_ += len;
+			return true;
+		}
+
+		static double half(uint16_t h)
+		{
+			int e = (h >> 10) & 0x1f;
+			int m = h & 0x3ff;
+			double v;
+			if (e == 0) v = ldexp(m, -24);
+			else if (e != 31) v = ldexp(m + 1024, e - 25);
+			else v = m == 0 ? HUGE_VAL : NAN;
+			return (h & 0x8000) ? -v : v;
+		}
+
+		bool item(Handler& h, int depth)
+		{
+			if (depth > max_depth || !need(1)) return false;
+			uint8_t ib = *p_++;
+			int major = ib >> 5;
+			uint64_t v;
+			bool indefinite;
+			if (major != major_simple && !head(ib, v, indefinite)) return false;
+			switch (major) {
+			case major_uint:
+				return h.Uint64(v);
+			case major_nint:
+				if (v > (uint64_t)INT64_MAX) return h.Double(-1.0 - (double)v);
+				return h.Int64(-1 - (int64_t)v);
+			case major_bytes:
+			case major_text: {
+				const char* s;
+				if (indefinite || !text(v, s)) return false;
+				return h.String(s, (rapidjson::SizeType)v, true);
+			}
+			case major_array: {
+				if (!h.StartArray()) return false;
+				rapidjson::SizeType n = 0;
+				for (; indefinite ? !is_break() : n < v; ++n) {
+					if (!item(h, depth + 1)) return false;
+				}
+				if (indefinite) p_++;
+				return h.EndArray(n);
+			}
+			case major_map: {
+				if (!h.StartObject()) return false;
+				rapidjson::SizeType n = 0;
+				for (; indefinite ? !is_break() : n < v; ++n) {
+					if (!need(1)) return false;
+					uint8_t kb = *p_++;
+					uint64_t klen;
+					bool kindef;
+					const char* k;
+					if ((kb >> 5) != major_text || !head(kb, klen, kindef) || kindef || !text(klen, k)) return false;
+					if (!h.Key(k, (rapidjson::SizeType)klen, true)) return false;
+					if (!item(h, depth + 1)) return false;
+				}
+				if (indefinite) p_++;
+				return h.EndObject(n);
+			}
+			case major_tag:
+				return item(h, depth + 1);
+			default:
+				break;
+			}
+			switch (ib) {
+			case 0xf4: return h.Bool(false);
+			case 0xf5: return h.Bool(true);
+			case 0xf6:
+			case 0xf7: return h.Null();
+			case 0xf9: {
+				if (!be(2, v)) return false;
+				return h.Double(half((uint16_t)v));
+			}
+			case 0xfa: {
+				if (!be(4, v)) return false;
+				uint32_t u = (uint32_t)v;
+				float f;
+				memcpy(&f, &u, sizeof(f));
+				return h.Double(f);
+			}
+			case 0xfb: {
+				if (!be(8, v)) return false;
+				double d;
+				memcpy(&d, &v, sizeof(d));
+				return h.Double(d);
+			}
+			default:
+				return false;
+			}
+		}
+
+	private:
+		const uint8_t* p_;
+		const uint8_t* end_;
+		bool           ok_;
+	};
+
+	inline bool parse(const char* buf, size_t len, rapidjson::Document& d)
+	{
+		reader<rapidjson::Document> r(buf, len);
+		d.Populate(r);
+		return r.ok();
+	}
+
+	// Rewrites a CBOR message as JSON text in place, for peers that only
+	// speak JSON; JSON messages are left alone.
+	inline bool to_json(std::string& msg)
+	{
+		if (!is_cbor(msg.data(), msg.size())) {
+			return true;
+		}
+		rapidjson::Document d;
+		if (!parse(msg.data(), msg.size(), d)) {
+			return false;
+		}
+		rapidjson::StringBuffer buffer;
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+		d.Accept(writer);
+		msg.assign(buffer.GetString(), buffer.GetSize());
+		return true;
+	}
+}}
@@ -3,9 +3,26 @@
 #include <net/tcp/connecter.h>
 #include <net/poller.h>
 #include <debugger/protocol.h>
+#include <debugger/io/stream.h>
 
 class stdinput;
 
+// Reassembles the debuggee's frames so compressed ones can be expanded
+// before they are forwarded to the client, which only speaks plain framing.
+class tcp_decoder
+	: public vscode::io::stream
+{
+public:
+	void   push(const char* buf, size_t len);
+	size_t raw_peek();
+	bool   raw_recv(char* buf, size_t len);
+	bool   raw_send(const char* buf, size_t len);
+	void   close();
+
+private:
+	std::string pending_;
+};
+
 class tcp_attach
 	: public net::tcp::connecter
 {
@@ -21,4 +38,5 @@ public:
 private:
 	net::poller_t poller;
 	stdinput&     io;
+	tcp_decoder   decoder;
 };
@@ -1,31 +1,49 @@
 #pragma once
 
 #include <debugger/lua.h>
+#include <map>
+#include <vector>
 
 namespace vscode {
 	struct source;
 
+	// Virtual sources of a transpiled language, and the storage of the
+	// lua::Debug records their events are reported with. Records are handed
+	// out in stack order, so nested events only allocate past `depth`.
 	struct vdebugMgr {
+		static const size_t depth = 8;
+
 		source* s = nullptr;
 		void event_call(source* source);
 		void event_return();
 		source* get_source();
+		int     add_source(source* source);
+		source* find_source(int handle);
+		lua::Debug* alloc();
+		void        free(lua::Debug* vr);
+
+	private:
+		std::vector<source*>   handles_;
+		std::map<source*, int> index_;
+		lua::Debug             records_[depth];
+		size_t                 used_ = 0;
 	};
 
 	struct debug {
 		lua_State* lua;
 		lua::Debug* ar;
 		lua::Debug* vr;
+		vdebugMgr*  mgr = nullptr;
 		int         scope = -1;
 
 		debug(lua_State* l, lua::Debug* a);
-		debug(lua_State* l);
+		debug(lua_State* l, vdebugMgr& m);
 		debug(debug& o);
 		~debug();
 
-		static debug event_call(lua_State* l);
-		static debug event_return(lua_State* l);
-		static debug event_line(lua_State* l, int currentline, int scope);
+		static debug event_call(lua_State* l, vdebugMgr& m);
+		static debug event_return(lua_State* l, vdebugMgr& m);
+		static debug event_line(lua_State* l, vdebugMgr& m, int currentline, int scope);
 
 		bool is_virtual();
 		lua_State* L();
@@ -65,6 +65,10 @@ namespace vscode
 		bool set_config(int level, const std::string& cfg, std::string& err);
 		void init_internal_module(lua_State* L);
 		void event(const char* name, lua_State* L, int argf, int argl);
+		int  vsource(const char* code, size_t len, const char* name = nullptr);
+		bool vcall(lua_State* L, int handle);
+		void vreturn(lua_State* L);
+		void vline(lua_State* L, int line, int scope = -1);
 
 	private:
 		debugger_impl* impl_;
@@ -79,4 +83,6 @@ DEBUGGER_API vscode::debugger* debugger_get();
 extern "C" {
 	DEBUGGER_API int  luaopen_debugger(lua_State* L);
 	DEBUGGER_API void debugger_set_luadll(void* luadll, void* getluaapi);
+	// Wakes a debugger put to sleep by `dbg:dormant()`; async-signal-safe.
+	DEBUGGER_API void debugger_activate();
 }
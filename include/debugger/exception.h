@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <debugger/debugger.h>
+#include <debugger/protocol.h>
+#include <debugger/stats.h>
+
+struct lua_State;
+
+namespace vscode
+{
+	// Enabled exception filters with their message conditions, and a table
+	// of throwing sites (function + line) counting how often each throws.
+	class exceptionMgr
+	{
+	public:
+		void clear();
+		void set_breakpoints(rapidjson::Value const& args);
+		void set_stops(size_t stops) { stops_ = stops; }
+		bool empty() const { return filters_.empty(); }
+		bool enabled(eException type) const { return filters_.find(type) != filters_.end(); }
+		// Called with the error object on top of the stack of L; counts
+		// the throwing site and tells whether to stop there.
+		bool hit(lua_State* L, eException type);
+		void output_sites(wprotocol& res, size_t count, std::function<void(const std::string&, wprotocol&)> source);
+		void reset_sites();
+		memory_usage site_usage() const;
+
+		static bool match(const std::string& pattern, const char* str, size_t len);
+
+	private:
+		struct site {
+			std::string source;
+			int         line;
+			uint64_t    hits;
+			uint64_t    stops;
+			std::string message;
+		};
+		struct site_key {
+			intptr_t f;
+			int      line;
+			bool operator==(const site_key& r) const { return f == r.f && line == r.line; }
+		};
+		struct site_hash {
+			size_t operator()(const site_key& k) const { return std::hash<intptr_t>()(k.f) ^ ((size_t)k.line * 0x9E3779B9); }
+		};
+
+		void evict();
+
+	private:
+		static const size_t site_limit = 4096;
+		std::map<eException, std::string>                 filters_;
+		std::unordered_map<site_key, site, site_hash>     sites_;
+		size_t                                            stops_ = 0;
+		uint64_t                                          untracked_ = 0;
+	};
+}
@@ -48,11 +48,11 @@ namespace vscode {
 			return 0;
 		}
 
-		void put(uintptr_t key, T* value) {
+		bool put(uintptr_t key, T* value) {
 			hashnode<T>* node = get_node(key);
 			if (node) {
 				node->value = value;
-				return;
+				return false;
 			}
 			if (pos == N) {
 				chunk_type* c = new chunk_type;
@@ -63,16 +63,18 @@ namespace vscode {
 			back_chunk->data[pos].key = key;
 			back_chunk->data[pos].value = value;
 			pos++;
+			return true;
 		}
 
-		void del(uintptr_t key) {
+		bool del(uintptr_t key) {
 			hashnode<T>* node = get_node(key);
 			if (!node) {
-				return;
+				return false;
 			}
-			node->key = back_chunk[pos].key;
-			node->value = back_chunk[pos].value;
+			node->key = back_chunk->data[pos - 1].key;
+			node->value = back_chunk->data[pos - 1].value;
 			del_back();
+			return true;
 		}
 
         void clear() {
@@ -85,6 +87,14 @@ namespace vscode {
             pos = 0;
         }
 
+		size_t chunks() const {
+			size_t n = 1;
+			for (chunk_type* c = front_chunk; c != back_chunk; c = c->next) {
+				n++;
+			}
+			return n;
+		}
+
 	private:
 		hashnode<T>* get_node(uintptr_t key) {
 			for (chunk_type* c = front_chunk; c != back_chunk; c = c->next) {
@@ -136,16 +146,29 @@ namespace vscode {
 			return buckets[key % BucketSize].get(key);
 		}
 		void put(uintptr_t key, T* value) {
-			return buckets[key % BucketSize].put(key, value);
+			if (buckets[key % BucketSize].put(key, value))
+				size_++;
 		}
 		void del(uintptr_t key) {
-			return buckets[key % BucketSize].del(key);
+			if (buckets[key % BucketSize].del(key))
+				size_--;
 		}
         void clear() {
             for (size_t i = 0; i < BucketSize; ++i)
                 buckets[i].clear();
+            size_ = 0;
         }
+		size_t size() const {
+			return size_;
+		}
+		size_t bytes() const {
+			size_t n = 0;
+			for (size_t i = 0; i < BucketSize; ++i)
+				n += buckets[i].chunks();
+			return sizeof(*this) + n * sizeof(hashchunk<T, ChunkSize>);
+		}
 	private:
 		hashbucket<T, ChunkSize> buckets[BucketSize];
+		size_t                   size_ = 0;
 	};
 }
@@ -7,10 +7,14 @@
 #include <vector> 
 #include <mutex>
 #include <atomic>
+#include <chrono>
 #include <stdint.h>
 #include <rapidjson/document.h>
 #include <debugger/lua.h>
 #include <debugger/breakpoint.h>
+#include <debugger/exception.h>
+#include <debugger/threadmgr.h>
+#include <debugger/output.h>
 #include <debugger/source.h>
 #include <debugger/protocol.h>
 #include <debugger/debugger.h>
@@ -20,6 +24,8 @@
 #include <debugger/io/helper.h>
 #include <debugger/osthread.h>
 #include <debugger/debugapi.h>
+#include <debugger/stats.h>
+#include <debugger/lru.h>
 #include <base/util/string_view.h>
 
 namespace vscode
@@ -29,7 +35,30 @@ namespace vscode
 	struct luathread;
 	typedef std::map<std::string_view, std::string_view> translator_t;
 	typedef std::vector<std::pair<std::string, std::string>> sourcemap_t;
-	typedef std::vector<std::string>                         skipfiles_t;
+
+	enum class eOutputPolicy {
+		block,
+		drop,
+		coalesce,
+	};
+
+	struct output_stats {
+		uint64_t dropped_messages = 0;
+		uint64_t dropped_bytes = 0;
+		uint64_t coalesced_bytes = 0;
+		uint64_t merged_messages = 0;
+		uint64_t suppressed_lines = 0;
+	};
+
+	// Output waiting to be merged with the next message of the same category
+	// and source, see outputMergeWindow.
+	struct output_pending {
+		std::string category;
+		std::string text;
+		source*     src = nullptr;
+		int         line = 0;
+		std::chrono::steady_clock::time_point time;
+	};
 
 	class debugger_impl
 	{
@@ -58,8 +87,11 @@ namespace vscode
 		void on_disconnect();
 		void init_internal_module(lua_State* L);
 		void event(const char* name, lua_State* L, int argf, int argl);
-		source* createSource(lua::Debug* ar);
-		bool    getCode(uint32_t ref, std::string& code);
+		int  vsource(const char* code, size_t len, const char* name);
+		bool vcall(lua_State* L, int handle);
+		void vreturn(lua_State* L);
+		void vline(lua_State* L, int line, int scope);
+		source* createSource(lua::Debug* ar, lua_State* L = nullptr, int fidx = 0);
 		source* openVSource();
 
 		void set_stepping(const char* reason);
@@ -86,6 +118,8 @@ namespace vscode
 		bool request_disconnect(rprotocol& req);
 		bool request_pause(rprotocol& req);
 		bool request_set_exception_breakpoints(rprotocol& req);
+		bool request_debugger_stats(rprotocol& req);
+		bool request_exception_sites(rprotocol& req);
 
 	private:
 		bool request_threads(rprotocol& req, debug& debug);
@@ -120,14 +154,29 @@ namespace vscode
 
 	private:
 		void response_initialize(rprotocol& req);
-		void response_threads(rprotocol& req);
+		void response_threads(rprotocol& req, luathread* current);
 		void response_source(rprotocol& req, const std::string& content);
 
 	private:
 		void detach_all(bool release);
+		bool hook_unlocked(luathread* thread, debug& debug);
 		bool update_main(rprotocol& req, bool& quit);
 		bool update_hook(rprotocol& req, debug& debug, bool& quit);
 		void update_redirect();
+		void network_update();
+		void output_wait();
+		bool output_enqueue(output_queue& queue, output_record& rec);
+		void output_drain(output_queue& queue, size_t blockLimit);
+		size_t output_queued();
+		bool output_admit(const char* category, const char* buf, size_t len);
+		void output_flush();
+		void output_event(const char* category, const char* buf, size_t len, source* s = nullptr, int line = 0);
+		source* output_source(lua_State* L, lua::Debug* ar, int& line);
+		void output_merge(const char* category, const char* buf, size_t len, source* s, int line);
+		void output_merge_flush(bool force);
+		void output_pending_flush();
+		void output_suppressed_flush(bool force);
+		void output_limited(const char* category, const char* buf, size_t len, source* s, int line);
 
 	private:
 		void        initialize_pathconvert(config& config);
@@ -140,14 +189,25 @@ namespace vscode
 		bool        path_convert(const std::string& source, std::string& client);
 		std::string path_clientrelative(const std::string& path);
 
+	public:
+		debugger_stats& stats() { return stats_; }
+		size_t variable_limit() const { return variableLimit_; }
+		size_t watch_limit() const { return watchLimit_; }
+		// Makes every luathread drop what it cached about breakpoints and
+		// exception filters; call with thread_ held.
+		void bump_epoch() { epoch_++; }
+
+	private:
+		void stats_dump();
+
 	private:
 		custom*                     custom_;
 		eCoding                     consoleSourceCoding_;
 		eCoding                     consoleTargetCoding_;
 		eCoding                     sourceCoding_;
 		std::string                 workspaceFolder_;
-		sourcemap_t                 sourceMap_;
-		skipfiles_t                 skipFiles_;
+		path::prefix_map            sourceMap_;
+		path::glob_set              skipFiles_;
 		std::function<void()>       on_clientattach_;
 #if defined(_WIN32)
 		std::unique_ptr<redirector> stdout_;
@@ -166,15 +226,55 @@ namespace vscode
 		breakpointMgr        breakpointmgr_;
 		sourceMgr            sourcemgr_;
 		vdebugMgr            vdebugmgr_;
-		std::map<int, std::unique_ptr<luathread>> luathreads_;
-		std::map<std::string, std::string> source2client_;
+		exceptionMgr         exceptionmgr_;
+		threadMgr            luathreads_;
+		lru_map<std::string, std::string> source2client_;
 
 		int64_t              seq;
-		int                  next_threadid_;
-		std::set<eException> exception_;
-		eState               state_;
+		std::atomic<eState>  state_;
+		// Bumped whenever breakpoints or exception filters change; a luathread
+		// trusts its cached view of them only while this matches.
+		std::atomic<uint32_t> epoch_;
+		// Threads in run_stopped. While one is stopped every hook takes
+		// thread_, so the others stop too even in code with no breakpoint.
+		std::atomic<int>     stopped_;
 		std::string          stopReason_;
 		lua_State*           redirectL_;
 		bool                 attach_;
+		eOutputPolicy        outputPolicy_;
+		size_t               outputLimit_;
+		// outputLimit_ under the block policy, else 0, and network_->send_size()
+		// as of the last update: read by printing threads without thread_.
+		std::atomic<size_t>  outputBlockLimit_;
+		std::atomic<size_t>  sendBacklog_;
+		sourcemap_t          outputCoalesced_;
+		size_t               outputCoalescedSize_;
+		uint64_t             outputDropped_;
+		output_stats         outputStats_;
+		// Output of lua_States that are not attached. Each luathread has a
+		// queue of its own; this one is shared, so its producers take turns.
+		output_queue         outputQueue_;
+		std::mutex           outputQueueMtx_;
+		// outputLimit_ under the drop and coalesce policies, else 0: a full
+		// luathread queue then drops instead of growing. Counts what it
+		// dropped until the debugger thread adds it to outputDropped_.
+		std::atomic<size_t>  outputDropLimit_;
+		std::atomic<uint64_t> outputQueueDropped_;
+		std::atomic<uint64_t> outputQueueDroppedBytes_;
+		output_pending       outputPending_;
+		int                  outputMergeWindow_;
+		size_t               outputMergeBytes_;
+		uint32_t             outputRate_;
+		uint32_t             outputRateCount_;
+		uint64_t             outputSuppressed_;
+		std::chrono::steady_clock::time_point outputRateTime_;
+		size_t               loadedSourceBatch_;
+		size_t               loadedSourceLimit_;
+		debugger_stats       stats_;
+		int                  statsInterval_;
+		std::chrono::steady_clock::time_point statsTime_;
+		size_t               variableLimit_;
+		size_t               watchLimit_;
+		size_t               threadLimit_;
 	};
 }
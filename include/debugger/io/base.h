@@ -20,5 +20,7 @@ namespace vscode { namespace io {
 		virtual bool input(std::string& buf) = 0;
 		virtual void close() = 0;
 		virtual void on_close_event(CloseEvent fn, void* ud) { };
+		// Bytes accepted by output() that the transport has not sent yet.
+		virtual size_t send_size() { return 0; }
 	};
 }}
@@ -17,7 +17,7 @@ namespace vscode {
 		std::unique_ptr<rapidjson::SchemaDocument> doc;
 	};
 
-	rprotocol io_input (io::base* io, schema* schema = nullptr);
+	rprotocol io_input (io::base* io, schema* schema = nullptr, size_t* len = nullptr);
 	void      io_output(io::base* io, const wprotocol& wp);
 	void      io_output(io::base* io, const rprotocol& rp);
 }
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// LZ4 block format codec used for Content-Encoding: lz4 frames.
+// The payload of such a frame is the uncompressed size (uint32, little
+// endian) followed by one LZ4 block.
+
+namespace vscode { namespace io { namespace lz4 {
+	enum {
+		hash_log = 12,
+	};
+
+	struct context {
+		uint32_t table[1 << hash_log];
+	};
+
+	// Appends the frame payload for [src, src+len) to `out`.
+	void compress(context& ctx, const char* src, size_t len, std::string& out);
+	// Replaces `out` with the decoded payload; false if the frame is malformed.
+	bool decompress(const char* src, size_t len, std::string& out);
+}}}
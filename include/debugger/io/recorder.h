@@ -0,0 +1,45 @@
+#pragma once
+
+#include <debugger/io/base.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace vscode { namespace io {
+	// One message of a recorded session. `time` is in microseconds since the
+	// recorder was opened; `in` is true for messages read from the client.
+	struct record_entry {
+		uint64_t    time;
+		bool        in;
+		std::string data;
+	};
+
+	// Decorates a transport and appends every message that passes through
+	// it to a file, as a "<time> <in|out> <size>" line followed by the raw
+	// message and a newline.
+	class DEBUGGER_API recorder
+		: public base
+	{
+	public:
+		recorder(base* io, const char* path);
+		~recorder();
+		void   update(int ms);
+		bool   output(const char* buf, size_t len);
+		bool   input(std::string& buf);
+		void   close();
+		void   on_close_event(CloseEvent fn, void* ud);
+		size_t send_size();
+
+	private:
+		void   write(bool in, const char* buf, size_t len);
+
+	private:
+		base*    io_;
+		FILE*    file_;
+		uint64_t start_;
+	};
+
+	DEBUGGER_API bool read_recording(const char* path, std::vector<record_entry>& entries);
+	DEBUGGER_API uint64_t record_clock();
+}}
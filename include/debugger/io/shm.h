@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <debugger/io/base.h>
+
+namespace vscode { namespace io {
+	struct shm_region;
+	struct shm_ring;
+
+	// Same-host transport over a POSIX shared memory object holding two
+	// single-producer/single-consumer byte rings, one per direction.
+	// Messages are length-prefixed, so no Content-Length parsing is needed.
+	class DEBUGGER_API shm
+		: public base
+	{
+	public:
+		shm();
+		~shm();
+		bool   open_server(std::string const& name);
+		bool   open_client(std::string const& name);
+		void   update(int ms);
+		bool   output(const char* buf, size_t len);
+		bool   input(std::string& buf);
+		void   close();
+		bool   is_closed() const;
+		void   on_close_event(CloseEvent fn, void* ud);
+		size_t send_size();
+
+	private:
+		bool   listen();
+		bool   attach();
+		void   detach();
+		void   reset();
+		bool   peer_alive() const;
+		void   flush();
+		size_t recv();
+		void   wait(int ms);
+		shm_ring* rd() const;
+		shm_ring* wr() const;
+
+	private:
+		bool        server_ = false;
+		bool        connected_ = false;
+		std::string name_;
+		shm_region* region_ = nullptr;
+#if defined(_WIN32)
+#pragma warning(push)
+#pragma warning(disable:4251)
+#endif
+		std::string sendbuf_;
+		std::string recvbuf_;
+		std::deque<std::string> queue_;
+#if defined(_WIN32)
+#pragma warning(pop)
+#endif
+		size_t      sendpos_ = 0;
+		size_t      recvpos_ = 0;
+		CloseEvent  close_event_fn = nullptr;
+		void*       close_event_ud = nullptr;
+	};
+}}
@@ -17,9 +17,12 @@ namespace vscode { namespace io {
 	{
 	public:
 		sock_stream();
+		// False for a unix: path too long for sun_path.
+		static bool valid_address(const char* addr);
 		size_t raw_peek();
 		bool raw_recv(char* buf, size_t len);
 		bool raw_send(const char* buf, size_t len);
+		size_t send_size();
 		void open(sock_session* s);
 		void close();
 		bool is_closed() const;
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <debugger/io/base.h>
+#include <debugger/io/lz4.h>
 #include <readerwriterqueue.h>
+#include <memory>
 
 namespace vscode { namespace io {
 	struct DEBUGGER_API stream
@@ -17,16 +19,28 @@ namespace vscode { namespace io {
 		bool output(const char* buf, size_t len);
 		bool input(std::string& buf);
 		void clear();
+		void fail();
+		bool parse_header(size_t pos, size_t end);
+		bool enqueue(const char* data, size_t n);
 #if defined(_WIN32)
 #pragma warning(push)
 #pragma warning(disable:4251)
 #endif
 		moodycamel::ReaderWriterQueue<std::string, 8> queue;
 		std::string                buf;
+		std::string                zbuf;
+		std::unique_ptr<lz4::context> lz4ctx;
 #if defined(_WIN32)
 #pragma warning(pop)
 #endif
 		size_t                     stat;
 		size_t                     len;
+		bool                       compressed;
+		// Compression is negotiated per connection: we advertise it with
+		// Accept-Encoding when accept_encoding is set, and only compress
+		// messages of at least compress_threshold bytes once the peer has.
+		bool                       accept_encoding;
+		bool                       peer_accept;
+		size_t                     compress_threshold;
 	};
 }}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <map>
+#include <stddef.h>
+
+namespace vscode {
+	// Ordered map that forgets its least recently used entries once it holds
+	// more than `entries` of them or more than `bytes` in total. The cost of
+	// an entry is given by the caller and includes the node overhead. A limit
+	// of 0 means unlimited.
+	template <class Key, class Value, class Compare = std::less<Key>>
+	class lru_map {
+		struct entry;
+		typedef std::map<Key, entry, Compare>       map_type;
+		typedef std::list<typename map_type::iterator> list_type;
+		struct entry {
+			Value                        value;
+			size_t                       cost;
+			typename list_type::iterator pos;
+		};
+
+	public:
+		static const size_t overhead = sizeof(typename map_type::value_type) + 4 * sizeof(void*) + 3 * sizeof(void*);
+
+		Value* get(const Key& key)
+		{
+			auto it = map_.find(key);
+			if (it == map_.end()) {
+				return nullptr;
+			}
+			order_.splice(order_.begin(), order_, it->second.pos);
+			return &it->second.value;
+		}
+
+		Value& put(const Key& key, Value value, size_t cost)
+		{
+			cost += overhead;
+			auto it = map_.find(key);
+			if (it != map_.end()) {
+				bytes_ -= it->second.cost;
+				it->second.value = std::move(value);
+				it->second.cost = cost;
+				order_.splice(order_.begin(), order_, it->second.pos);
+			}
+			else {
+				it = map_.insert(std::make_pair(key, entry { std::move(value), cost, order_.end() })).first;
+				order_.push_front(it);
+				it->second.pos = order_.begin();
+			}
+			bytes_ += cost;
+			evict(it);
+			return it->second.value;
+		}
+
+		void set_limit(size_t entries, size_t bytes)
+		{
+			max_entries_ = entries;
+			max_bytes_ = bytes;
+			evict(map_.end());
+		}
+
+		void clear()
+		{
+			order_.clear();
+			map_.clear();
+			bytes_ = 0;
+		}
+
+		size_t size() const       { return map_.size(); }
+		size_t bytes() const      { return bytes_; }
+		size_t max_entries() const { return max_entries_; }
+		size_t max_bytes() const  { return max_bytes_; }
+
+	private:
+		// Never evicts `keep`, the entry that was just inserted.
+		void evict(typename map_type::iterator keep)
+		{
+			while (!order_.empty() && ((max_entries_ && map_.size() > max_entries_) || (max_bytes_ && bytes_ > max_bytes_))) {
+				auto it = order_.back();
+				if (it == keep) {
+					break;
+				}
+				order_.pop_back();
+				bytes_ -= it->second.cost;
+				map_.erase(it);
+			}
+		}
+
+		map_type  map_;
+		list_type order_;
+		size_t    bytes_ = 0;
+		size_t    max_entries_ = 0;
+		size_t    max_bytes_ = 0;
+	};
+}
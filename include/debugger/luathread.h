@@ -1,14 +1,31 @@
 #pragma once
 
 #include <debugger/lua.h>
+#include <memory>
+#include <unordered_map>
 #include <debugger/breakpoint.h>
 #include <debugger/observer.h>
+#include <debugger/stats.h>
 #include <debugger/thunk/thunk.h>
+#include <debugger/output.h>
 
 namespace vscode
 {
 	class debugger_impl;
 	class breakpointMgr;
+	struct luathread;
+
+	// Owned by the registry of a lua_State and shared by its coroutines,
+	// which inherit the hook (and LUA_EXTRASPACE) of the thread creating
+	// them. It lives until lua_close, so a coroutine created while attached
+	// finds `thread` cleared after a detach instead of a dangling pointer,
+	// and its hook trampoline is never handed to another state.
+	struct hook_anchor {
+		luathread* thread = nullptr;
+#if !defined(DEBUGGER_EXTRASPACE_HOOK)
+		std::unique_ptr<thunk> hook;
+#endif
+	};
 
 	struct luathread {
 		enum class step {
@@ -23,8 +40,10 @@ namespace vscode
 		bool           busy;
 		debugger_impl& dbg;
 		lua_State*     L;
-		std::unique_ptr<thunk> thunk_hook;
+		hook_anchor*   anchor;
+#if !defined(DEBUGGER_EXTRASPACE_HOOK)
 		std::unique_ptr<thunk> thunk_panic;
+#endif
 		lua_CFunction  oldpanic;
 
 		step           step_;
@@ -34,11 +53,24 @@ namespace vscode
 		bool           has_function;
 		bool           has_breakpoint;
 		bp_source*     cur_function;
+		// Functions known to have no breakpoint, by proto, valid for `epoch`.
+		std::unordered_map<intptr_t, bp_source*> clean_functions;
+		uint32_t       epoch;
+		bool           has_exception;
 		observer       ob_;
+#if !defined(DEBUGGER_DISABLE_STATS)
+		hook_stats     stats;
+#endif
+		// Filled by the thread running L, drained by whoever holds thread_.
+		output_queue   output;
 
 		luathread(int id, debugger_impl& dbg, lua_State* L);
 		~luathread();
 
+		// The luathread attached to L's state, if any. Only reads L, so it
+		// needs no lock but must be called on the thread running L.
+		static luathread* get(lua_State* L);
+
 		void install_hook(int mask);
 
 		void release_thread();
@@ -52,7 +84,8 @@ namespace vscode
 		void step_out(lua_State* L);
 		void hook_callret(debug& debug);
 		void hook_line(debug& debug, breakpointMgr& breakpointmgr);
-		void update_breakpoint();
+		bool hook_running(debug& debug);
+		void update_epoch(uint32_t epoch, bool exception);
 
 		void reset_session(lua_State* L);
 		void evaluate(lua_State* L, lua::Debug *ar, debugger_impl& dbg, rprotocol& req, int frameId);
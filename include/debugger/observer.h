@@ -44,9 +44,10 @@ namespace vscode {
 		std::vector<value> values;
 		int frameId;
 		int threadId;
+		size_t limit;
 		int64_t new_variable(size_t parent, value::Type type, int index);
 
-		frame(int threadId, int frameId);
+		frame(int threadId, int frameId, size_t limit);
 		void new_scope(debug& debug, lua::Debug* ar, wprotocol& res);
 		void clear();
 		bool push_value(debug& debug, size_t value_idx);
@@ -73,11 +74,13 @@ namespace vscode {
 	struct observer {
 		std::map<int, frame> frames;
 		int                  threadId;
+		size_t               watches;
 
 		observer(int threadId);
 		void    reset(lua_State* L = nullptr);
-		frame*  create_or_get_frame(int frameId);
-		int64_t new_watch(lua_State* L, int idx, frame* frame, const std::string& expression);
+		frame*  create_or_get_frame(debugger_impl& dbg, int frameId);
+		int64_t new_watch(lua_State* L, int idx, frame* frame, const std::string& expression, size_t limit);
+		void    usage(memory_usage& variables, memory_usage& watch) const;
 		void    evaluate(lua_State* L, lua::Debug *ar, debugger_impl& dbg, rprotocol& req, int frameId);
 		void    new_frame(debug& debug, debugger_impl& dbg, rprotocol& req, int frameId);
 		void    get_variable(debug& debug, debugger_impl& dbg, rprotocol& req, int64_t valueId, int frameId);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <readerwriterqueue.h>
+
+namespace vscode
+{
+	// Output captured on a Lua thread, waiting for the debugger thread to
+	// encode it. `category` must be a string literal. `chunkname` is only
+	// set for a file chunk ('@' or '='); an in-memory chunk is known by its
+	// content key instead, and `code` carries its text the first time.
+	struct output_record {
+		const char* category;
+		std::string text;
+		std::string chunkname;
+		uint64_t    key;
+		std::string code;
+		int         line;
+	};
+	typedef moodycamel::ReaderWriterQueue<output_record> output_queue;
+}
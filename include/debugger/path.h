@@ -1,6 +1,10 @@
-#pragma once 
+#pragma once
 
+#include <stdint.h>
 #include <string>
+#include <vector>
+#include <map>
+#include <array>
 
 namespace vscode { namespace path {
 	int tochar(char c);
@@ -8,6 +12,56 @@ namespace vscode { namespace path {
 	std::string relative(const std::string& path, const std::string& base, char sep);
 	std::string filename(const std::string& path);
 	bool        glob_match(const std::string& pattern, const std::string& target);
+	// Forget the working directory remembered by normalize.
+	void        reset_currentpath();
+
+	// A set of glob patterns ('*' and '?', compared with tochar) compiled
+	// into one automaton. All patterns are run together as a bit-parallel
+	// NFA, so a target is matched in one pass over its characters.
+	class glob_set {
+	public:
+		void clear();
+		void add(const std::string& pattern);
+		bool match(const std::string& target);
+		bool empty() const { return nfa_.empty(); }
+
+	private:
+		enum : int { any = -1, star = -2, accept = -3 };
+		typedef std::vector<uint64_t> bits;
+		void compile();
+
+	private:
+		std::vector<int>              nfa_;
+		std::vector<uint32_t>         starts_;
+		bool                          compiled_ = false;
+		size_t                        words_ = 0;
+		std::array<uint8_t, 256>      class_;
+		std::vector<bits>             advance_;
+		bits                          star_;
+		bits                          accept_;
+		bits                          start_;
+		bits                          cur_;
+		bits                          next_;
+	};
+
+	// Prefix -> replacement, compared with tochar. Among all prefixes of a
+	// target the one added first wins, as with a linear scan in add order.
+	class prefix_map {
+	public:
+		prefix_map();
+		void clear();
+		void add(const std::string& prefix, const std::string& replace);
+		bool apply(const std::string& target, std::string& result) const;
+
+	private:
+		static const size_t npos = (size_t)-1;
+		struct node {
+			std::map<int, uint32_t> child;
+			size_t                  entry = npos;
+		};
+		std::vector<node>                           nodes_;
+		std::vector<std::pair<size_t, std::string>> entries_;
+	};
 
 	template <class T> struct less;
 	template <> struct less<char> {
@@ -3,6 +3,9 @@
 #include <rapidjson/document.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/stringbuffer.h>
+#include <debugger/cbor.h>
+#include <atomic>
+#include <string.h>
 
 namespace vscode
 {
@@ -32,67 +35,117 @@ namespace vscode
 		}
 	};
 
+	enum class eEncoding {
+		json,
+		cbor,
+	};
+
+	// Builds one outgoing message. The encoding is fixed at construction and
+	// defaults to the one negotiated for the current session (see
+	// request_initialize); both encodings accept the same Handler calls.
 	class wprotocol
-		: public rapidjson::Writer < rapidjson::StringBuffer >
 	{
 	public:
-		typedef rapidjson::Writer<rapidjson::StringBuffer> base_type;
+		typedef char Ch;
+		typedef rapidjson::Writer<rapidjson::StringBuffer> json_writer;
 
 		wprotocol()
+			: wprotocol(default_encoding())
+		{
+		}
+
+		explicit wprotocol(eEncoding encoding)
 			: buf_()
-			, base_type(buf_)
+			, json_(buf_)
+			, cbor_()
+			, binary_(encoding == eEncoding::cbor)
+		{
+		}
+
+		static eEncoding default_encoding()
+		{
+			return encoding_().load(std::memory_order_relaxed);
+		}
+
+		static void default_encoding(eEncoding encoding)
 		{
+			encoding_().store(encoding, std::memory_order_relaxed);
+		}
+
+		eEncoding encoding() const
+		{
+			return binary_ ? eEncoding::cbor : eEncoding::json;
 		}
 
 		const char* data() const
 		{
-			return buf_.GetString();
+			return binary_ ? cbor_.data() : buf_.GetString();
 		}
 
 		size_t size() const
 		{
-			return buf_.GetSize();
+			return binary_ ? cbor_.size() : buf_.GetSize();
+		}
+
+		bool IsComplete() const
+		{
+			return binary_ ? cbor_.IsComplete() : json_.IsComplete();
 		}
 
+		bool Null() { return binary_ ? cbor_.Null() : json_.Null(); }
+		bool Bool(bool b) { return binary_ ? cbor_.Bool(b) : json_.Bool(b); }
+		bool Int(int i) { return binary_ ? cbor_.Int(i) : json_.Int(i); }
+		bool Uint(unsigned u) { return binary_ ? cbor_.Uint(u) : json_.Uint(u); }
+		bool Int64(int64_t i) { return binary_ ? cbor_.Int64(i) : json_.Int64(i); }
+		bool Uint64(uint64_t u) { return binary_ ? cbor_.Uint64(u) : json_.Uint64(u); }
+		bool Double(double d) { return binary_ ? cbor_.Double(d) : json_.Double(d); }
+		bool RawNumber(const Ch* str, rapidjson::SizeType len, bool copy = false) { return binary_ ? cbor_.RawNumber(str, len, copy) : json_.RawNumber(str, len, copy); }
+		bool String(const Ch* str, rapidjson::SizeType len, bool copy = false) { return binary_ ? cbor_.String(str, len, copy) : json_.String(str, len, copy); }
+		bool Key(const Ch* str, rapidjson::SizeType len, bool copy = false) { return binary_ ? cbor_.Key(str, len, copy) : json_.Key(str, len, copy); }
+		bool StartObject() { return binary_ ? cbor_.StartObject() : json_.StartObject(); }
+		bool EndObject(rapidjson::SizeType n = 0) { return binary_ ? cbor_.EndObject(n) : json_.EndObject(n); }
+		bool StartArray() { return binary_ ? cbor_.StartArray() : json_.StartArray(); }
+		bool EndArray(rapidjson::SizeType n = 0) { return binary_ ? cbor_.EndArray(n) : json_.EndArray(n); }
+
 		template <size_t n>
 		wprotocol& operator() (const char(&str)[n])
 		{
-			base_type::Key(str, n - 1);
+			Key(str, n - 1);
 			return *this;
 		}
 
 		wprotocol& operator() (const std::string& str)
 		{
-			base_type::Key(str);
+			Key(str.data(), static_cast<rapidjson::SizeType>(str.size()));
 			return *this;
 		}
 
 		wprotocol& operator() (const rapidjson::Value& str)
 		{
-			base_type::Key(str.GetString(), str.GetStringLength());
+			Key(str.GetString(), str.GetStringLength());
 			return *this;
 		}
 
 		bool String(const rapidjson::Value& str)
 		{
-			return base_type::String(str.GetString(), str.GetStringLength());
+			return String(str.GetString(), str.GetStringLength());
 		}
 
 		bool String(const char* str)
 		{
-			return base_type::String(str);
+			return String(str, static_cast<rapidjson::SizeType>(strlen(str)));
 		}
 
 		template <size_t n>
 		bool String(const char(&str)[n])
 		{
-			return base_type::String(str, n - 1);
+			return String(str, n - 1);
 		}
 
 		template <class T>
 		bool String(const T& str)
 		{
-			return base_type::String(str.data(), static_cast<rapidjson::SizeType>(str.size()));
+			return String(str.data(), static_cast<rapidjson::SizeType>(str.size()));
 		}
 
 		typedef bool (wprotocol::*ItorT)();
@@ -168,10 +221,10 @@ namespace vscode
 			size_t     n_;
 		};
 
-		bool ObjectBegin() { return base_type::StartObject(); }
-		bool ObjectEnd() { return base_type::EndObject(); }
-		bool ArrayBegin() { return base_type::StartArray(); }
-		bool ArrayEnd() { return base_type::EndArray(); }
+		bool ObjectBegin() { return StartObject(); }
+		bool ObjectEnd() { return EndObject(); }
+		bool ArrayBegin() { return StartArray(); }
+		bool ArrayEnd() { return EndArray(); }
 
 		typedef range<&wprotocol::ObjectBegin, &wprotocol::ObjectEnd> ObjectRangeT;
 		typedef range<&wprotocol::ArrayBegin, &wprotocol::ArrayEnd> ArrayRangeT;
@@ -179,7 +232,17 @@ namespace vscode
 		ObjectRangeT Object() { return ObjectRangeT(this, 1); }
 		ArrayRangeT  Array(size_t n = 1) { return ArrayRangeT(this, n); }
 
+	private:
+		static std::atomic<eEncoding>& encoding_()
+		{
+			static std::atomic<eEncoding> encoding(eEncoding::json);
+			return encoding;
+		}
+
 	private:
 		rapidjson::StringBuffer buf_;
+		json_writer             json_;
+		cbor::writer            cbor_;
+		bool                    binary_;
 	};
 }
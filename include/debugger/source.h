@@ -1,6 +1,11 @@
-#pragma once 
+#pragma once
 
 #include <debugger/breakpoint.h>
+#include <debugger/lru.h>
+#include <debugger/stats.h>
+#include <debugger/io/lz4.h>
+#include <memory>
+#include <unordered_map>
 
 namespace vscode {
 	class debugger_impl;
@@ -17,26 +22,74 @@ namespace vscode {
 		source();
 	};
 
+	// Text of an in-memory chunk, lz4-compressed when that saves space.
+	struct packed_code {
+		bool        lz4;
+		std::string data;
+	};
+
+	// An in-memory chunk, known by the 64-bit content key (a keyed hash) of
+	// its text. While `L` is set, a function of the chunk is weakly
+	// referenced from that state's registry and the text is only copied out
+	// when it is needed.
+	struct code_entry {
+		uint64_t   key;
+		lua_State* L;
+	};
+
+	// A chunk name seen in an activation record. `code` is set for
+	// in-memory chunks whose text is still reachable through a function.
+	struct chunk_entry {
+		source*     s;
+		code_entry* code;
+	};
+
+	typedef std::unordered_map<const char*, chunk_entry> chunk_map;
+
 	class sourceMgr {
 	public:
 		sourceMgr(debugger_impl& dbg);
-		source* create(lua::Debug* ar);
+		source* create(lua::Debug* ar, lua_State* L = nullptr, int fidx = 0);
+		source* create(const char* chunkname);
 		source* create(rapidjson::Value const& info);
-		source* createByRef(const std::string& code);
+		source* createByRef(const char* code, size_t len);
+		source* createByKey(uint64_t key, const std::string& code);
+		bool    outputKey(lua_State* L, lua::Debug* ar, uint64_t& key, std::string& code) const;
+		void    outputSeen(lua_State* L, lua::Debug* ar, uint64_t key) const;
 		source* open(rapidjson::Value const& info);
-		void    loadedSources(wprotocol& res);
-		bool    getCode(uint32_t ref, std::string& code);
+		void    loadedSources(wprotocol& res, size_t start, size_t count);
+		void    update(size_t batch, size_t limit);
+		bool    getCode(lua_State* L, uint32_t ref, std::string& code);
+		void    detach(lua_State* L, bool capture);
+		size_t  size() const { return sources_.size(); }
+		void    set_limit(size_t bytes);
+		memory_usage code_usage() const;
+		memory_usage chunk_usage() const;
 
 	private:
 		source*  createByPath(const std::string& path);
+		source*  createByRef(const char* code, size_t len, lua_State* L, lua::Debug* ar, int fidx);
 		source*  openByPath(const std::string& path);
 		source*  openByRef(uint32_t ref);
-		uint32_t codeHash(const std::string& s);
+		uint32_t newRef(uint64_t key, uint32_t seed);
+		void     remember(uint32_t ref, lua_State* L, int fidx);
+		bool     recall(code_entry& e, uint32_t ref, lua_State* L, std::string& code);
+		void     capture(uint64_t key, const char* code, size_t len);
+		bool     unpack(uint64_t key, std::string& code);
+		source*  createByChunk(lua::Debug* ar, lua_State* L, int fidx);
+		void     cacheChunk(chunk_map& chunks, const char* chunkname, source* s);
 
 	private:
 		debugger_impl& dbg_;
 		std::map<std::string, source, path::less<std::string>> poolPath_;
 		std::map<uint32_t, source>                             poolRef_;
-		std::map<uint32_t, std::string>                        poolCode_;
+		std::map<uint64_t, uint32_t>                           codeRef_;
+		std::map<uint32_t, code_entry>                         codes_;
+		lru_map<uint64_t, packed_code>                         poolCode_;
+		std::unique_ptr<io::lz4::context>                      lz4_;
+		std::unordered_map<lua_State*, chunk_map>              chunks_;
+		std::vector<source*>                                   sources_;
+		size_t                                                 notified_ = 0;
+		uint32_t                                               generation_;
 	};
 }
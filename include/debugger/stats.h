@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include <atomic>
+
+// Self-instrumentation, reported by the `debuggerStats` request. Everything
+// here is updated while holding debugger_impl::thread_, so plain integers
+// are enough, except hook_stats::unlocked, which counts by type the events
+// a Lua thread handled without it. Define DEBUGGER_DISABLE_STATS to compile it
+// out: the macros then expand to nothing and the request answers with an
+// error.
+
+namespace vscode
+{
+	class wprotocol;
+
+	enum class eStat {
+		hook_call,
+		hook_return,
+		hook_line,
+		hook_exception,
+		get_function_hit,
+		get_function_miss,
+		condition,
+		path_convert_hit,
+		path_convert_miss,
+		source_hit,
+		source_miss,
+		bytes_sent,
+		bytes_received,
+		messages_sent,
+		messages_received,
+		max,
+	};
+
+	// Log-linear histogram in the style of HdrHistogram: values below 16 are
+	// exact, above that every power of two is split into 16 buckets, so any
+	// reported percentile is within 1/16 of the recorded value.
+	struct histogram {
+		static const int sub_bits = 4;
+		static const int sub_count = 1 << sub_bits;
+		static const int bucket_count = (64 - sub_bits + 1) * sub_count;
+
+		uint64_t count = 0;
+		uint64_t sum = 0;
+		uint64_t min = 0;
+		uint64_t max = 0;
+		uint32_t buckets[bucket_count] = {};
+
+		void     record(uint64_t v);
+		uint64_t percentile(double q) const;
+		void     output(wprotocol& res) const;
+		void     reset();
+	};
+
+	// Footprint of one of the debugger's caches. `limit` is in the unit the
+	// cache is capped by (entries or bytes); 0 means unlimited.
+	struct memory_usage {
+		size_t entries;
+		size_t bytes;
+		size_t limit;
+
+		void output(wprotocol& res) const;
+	};
+
+	// Written by one thread only, so an increment is a plain load and store
+	// rather than a locked read-modify-write. Other threads reset it by
+	// moving `base`, never by storing to `n`, which an increment in flight
+	// would overwrite.
+	struct relaxed_counter {
+		std::atomic<uint64_t> n { 0 };
+		std::atomic<uint64_t> base { 0 };
+
+		void     add(uint64_t v) { n.store(n.load(std::memory_order_relaxed) + v, std::memory_order_relaxed); }
+		uint64_t get() const { return n.load(std::memory_order_relaxed) - base.load(std::memory_order_relaxed); }
+		void     reset() { base.store(n.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+	};
+
+	// `unlocked` is indexed by eStat::hook_call to eStat::hook_exception.
+	struct hook_stats {
+		static const size_t unlocked_count = (size_t)eStat::hook_exception + 1;
+
+		uint64_t        events = 0;
+		histogram       time;
+		relaxed_counter unlocked[unlocked_count];
+
+		uint64_t unlocked_total() const;
+		void     reset();
+	};
+
+	struct debugger_stats {
+		uint64_t  counters[(size_t)eStat::max] = {};
+		histogram hook_time;
+		histogram condition_time;
+		std::chrono::steady_clock::time_point since = std::chrono::steady_clock::now();
+
+		uint64_t get(eStat s) const { return counters[(size_t)s]; }
+		void     reset();
+	};
+
+	// Records the lifetime of the scope into a histogram, unless cancelled.
+	class stats_timer {
+	public:
+		stats_timer(histogram& h1, histogram* h2 = nullptr)
+			: h1_(&h1)
+			, h2_(h2)
+			, start_(std::chrono::steady_clock::now())
+		{ }
+		~stats_timer()
+		{
+			if (!h1_) {
+				return;
+			}
+			uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+			h1_->record(ns);
+			if (h2_) {
+				h2_->record(ns);
+			}
+		}
+		void cancel()
+		{
+			h1_ = nullptr;
+		}
+
+	private:
+		histogram* h1_;
+		histogram* h2_;
+		std::chrono::steady_clock::time_point start_;
+	};
+}
+
+#if defined(DEBUGGER_DISABLE_STATS)
+#	define DEBUGGER_STATS_ADD(stats, name, n) ((void)0)
+#	define DEBUGGER_STATS_TIMER(var, ...)
+#	define DEBUGGER_STATS_CANCEL(var) ((void)0)
+#else
+#	define DEBUGGER_STATS_ADD(stats, name, n) ((stats).counters[(size_t)::vscode::eStat::name] += (n))
+#	define DEBUGGER_STATS_TIMER(var, ...) ::vscode::stats_timer var(__VA_ARGS__)
+#	define DEBUGGER_STATS_CANCEL(var) (var).cancel()
+#endif
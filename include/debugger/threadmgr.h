@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+struct lua_State;
+
+namespace vscode
+{
+	class debugger_impl;
+	struct luathread;
+
+	// Attached lua_States. Records sit in a slab indexed by thread id, and
+	// the lowest free id is reused, so ids stay dense and fit the 16 bits
+	// that frame ids leave them. Lookup by lua_State (any of its coroutines)
+	// goes through a pointer-keyed hash.
+	class threadMgr
+	{
+	public:
+		static const int max_id = 0xFFFF;
+
+		class iterator {
+		public:
+			typedef std::vector<std::unique_ptr<luathread>>::const_iterator base;
+			iterator(base it, base end) : it_(it), end_(end) { skip(); }
+			luathread* operator*() const { return it_->get(); }
+			iterator& operator++() { ++it_; skip(); return *this; }
+			bool operator!=(const iterator& r) const { return it_ != r.it_; }
+		private:
+			void skip() { while (it_ != end_ && !*it_) ++it_; }
+			base it_;
+			base end_;
+		};
+
+		~threadMgr();
+		luathread* find(lua_State* L) const;
+		luathread* find(int id) const;
+		luathread* create(debugger_impl& dbg, lua_State* L);
+		void       erase(luathread* thread);
+		void       clear();
+		size_t     size() const { return states_.size(); }
+		bool       empty() const { return states_.empty(); }
+		iterator   begin() const { return iterator(slots_.begin(), slots_.end()); }
+		iterator   end() const { return iterator(slots_.end(), slots_.end()); }
+
+	private:
+		std::vector<std::unique_ptr<luathread>>    slots_;
+		std::vector<int>                           free_;
+		std::unordered_map<lua_State*, luathread*> states_;
+	};
+}
@@ -7,8 +7,9 @@
 #	else
 #		include "thunk_windows_i386.inl"
 #	endif
-#elif defined(__linux__)
+#elif defined(__linux__) && defined(__x86_64__)
 #	include "thunk_linux.inl"
+#	include "thunk_linux_amd64.inl"
 #else
 #	include "thunk_other.inl"
 #endif
@@ -1,16 +1,18 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 struct thunk;
 thunk* thunk_create_hook(intptr_t dbg, intptr_t hook);
 thunk* thunk_create_panic(intptr_t dbg, intptr_t panic, intptr_t old_panic);
 
-#if defined(_WIN32) || defined(__linux__)
+#if defined(_WIN32) || (defined(__linux__) && defined(__x86_64__))
 #	define thunk_bind(...)
 struct thunk {
 	void*  data = 0;
 	size_t size = 0;
+	void*  view = 0;
 	bool create(size_t s);
 	bool write(void* buf);
 	~thunk();
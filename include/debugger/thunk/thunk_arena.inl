@@ -0,0 +1,88 @@
+#include "thunk.h"
+#include <mutex>
+#include <vector>
+#include <memory.h>
+
+// Trampolines are carved out of shared chunks in fixed-size slots. Each
+// chunk is mapped twice: code is written through a read-write view and run
+// from a read-execute view of the same memory, so no page is ever writable
+// and executable, and filling a slot never disturbs its neighbours. When a
+// chunk cannot be mapped this way, a thunk gets a private page that is
+// sealed read-execute once written.
+
+static const size_t thunk_slot = 64;
+static const size_t thunk_chunk = 64 * 1024;
+
+struct thunk_arena {
+	std::mutex mtx;
+	std::vector<std::pair<char*, char*>> free;
+	bool unavailable = false;
+
+	bool alloc(char*& exec, char*& view) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (free.empty()) {
+			char* e;
+			char* v;
+			if (unavailable || !thunk_map(thunk_chunk, e, v)) {
+				unavailable = true;
+				return false;
+			}
+			for (size_t off = thunk_chunk; off > 0; off -= thunk_slot) {
+				free.push_back(std::make_pair(e + off - thunk_slot, v + off - thunk_slot));
+			}
+		}
+		exec = free.back().first;
+		view = free.back().second;
+		free.pop_back();
+		return true;
+	}
+
+	void release(char* exec, char* view) {
+		std::lock_guard<std::mutex> lock(mtx);
+		free.push_back(std::make_pair(exec, view));
+	}
+};
+
+// Never destroyed: thunks may outlive static destructors.
+static thunk_arena& arena() {
+	static thunk_arena* a = new thunk_arena;
+	return *a;
+}
+
+bool thunk::create(size_t s) {
+	char* e;
+	char* v;
+	if (s <= thunk_slot && arena().alloc(e, v)) {
+		data = e;
+		view = v;
+		size = s;
+		return true;
+	}
+	data = thunk_alloc_private(s);
+	if (!data) {
+		size = 0;
+		return false;
+	}
+	view = data;
+	size = s;
+	return true;
+}
+
+bool thunk::write(void* buf) {
+	memcpy(view, buf, size);
+	if (view == data && !thunk_seal(data, size)) {
+		return false;
+	}
+	thunk_flush(data, size);
+	return true;
+}
+
+thunk::~thunk() {
+	if (!data) return;
+	if (view != data) {
+		arena().release((char*)data, (char*)view);
+	}
+	else {
+		thunk_free_private(data, size);
+	}
+}
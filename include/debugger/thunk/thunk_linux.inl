@@ -0,0 +1,52 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if !defined(MFD_CLOEXEC)
+#	define MFD_CLOEXEC 1
+#endif
+
+static bool thunk_map(size_t size, char*& exec, char*& view) {
+#if defined(SYS_memfd_create)
+	int fd = (int)syscall(SYS_memfd_create, "lua-debug-thunk", MFD_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	if (ftruncate(fd, (off_t)size) != 0) {
+		close(fd);
+		return false;
+	}
+	void* v = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	void* e = mmap(NULL, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+	close(fd);
+	if (v == MAP_FAILED || e == MAP_FAILED) {
+		if (v != MAP_FAILED) munmap(v, size);
+		if (e != MAP_FAILED) munmap(e, size);
+		return false;
+	}
+	exec = (char*)e;
+	view = (char*)v;
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void* thunk_alloc_private(size_t size) {
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return data == MAP_FAILED ? 0 : data;
+}
+
+static bool thunk_seal(void* data, size_t size) {
+	return mprotect(data, size, PROT_READ | PROT_EXEC) == 0;
+}
+
+static void thunk_free_private(void* data, size_t size) {
+	munmap(data, size);
+}
+
+static void thunk_flush(void* data, size_t size) {
+	__builtin___clear_cache((char*)data, (char*)data + size);
+}
+
+#include "thunk_arena.inl"
@@ -1,28 +1,7 @@
 #include "thunk.h"
 #include <memory>
-#include <sys/mman.h>
 #include <memory.h>
 
-bool thunk::create(size_t s) {
-	data = mmap(NULL, s, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	if (!data) {
-		size = 0;
-		return false;
-	}
-	size = s;
-	return true;
-}
-
-bool thunk::write(void* buf) {
-	memcpy(data, buf, size);
-	return true;
-}
-
-thunk::~thunk() {
-	if (!data) return;
-	munmap(data, size);
-}
-
 thunk* thunk_create_hook(intptr_t dbg, intptr_t hook)
 {
 	// int __cedel thunk_hook(lua_State* L, lua_Debug* ar)
@@ -32,18 +11,18 @@ thunk* thunk_create_hook(intptr_t dbg, intptr_t hook)
 	// }
 	static unsigned char sc[] = {
 		0x50,                                                       // push rax
-		0x48, 0x83, 0xec, 0x28,                                     // sub rsp, 40
+		0x48, 0x83, 0xec, 0x20,                                     // sub rsp, 32
 		0x48, 0x89, 0xf2,                                           // mov rdx, rsi
 		0x48, 0x89, 0xfe,                                           // mov rsi, rdi
 		0x48, 0xbf, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // mov rdi, dbg
 		0x48, 0xb8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // mov rax, hook
 		0xff, 0xd0,                                                 // call rax
-		0x48, 0x83, 0xc4, 0x28,                                     // add rsp, 40
+		0x48, 0x83, 0xc4, 0x20,                                     // add rsp, 32
 		0x58,                                                       // pop rax
 		0xc3,                                                       // ret
 	};
 	std::unique_ptr<thunk> t(new thunk);
-	if (!shellcode_create(t.get(), sizeof(sc))) {
+	if (!t->create(sizeof(sc))) {
 		return 0;
 	}
 	memcpy(sc + 13, &dbg, sizeof(dbg));
@@ -63,17 +42,17 @@ thunk* thunk_create_panic(intptr_t dbg, intptr_t panic)
 	// }
 	static unsigned char sc[] = {
 		0x50,                                                       // push rax
-		0x48, 0x83, 0xec, 0x28,                                     // sub rsp, 40
+		0x48, 0x83, 0xec, 0x20,                                     // sub rsp, 32
 		0x48, 0x89, 0xfe,                                           // mov rsi, rdi
 		0x48, 0xbf, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // mov rdi, dbg
 		0x48, 0xb8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // mov rax, panic
 		0xff, 0xd0,                                                 // call rax
-		0x48, 0x83, 0xc4, 0x28,                                     // add rsp, 40
+		0x48, 0x83, 0xc4, 0x20,                                     // add rsp, 32
 		0x58,                                                       // pop rax
 		0xc3,                                                       // ret
 	};
 	std::unique_ptr<thunk> t(new thunk);
-	if (!shellcode_create(t.get(), sizeof(sc))) {
+	if (!t->create(sizeof(sc))) {
 		return 0;
 	}
 	memcpy(sc + 10, &dbg, sizeof(dbg));
@@ -105,15 +84,15 @@ thunk* thunk_create_panic(intptr_t dbg, intptr_t panic, intptr_t old_panic)
 		0xff, 0xd0,                                                 // call rax
 		0x48, 0x83, 0xc4, 0x28,                                     // add rsp, 40
 		0x5f,                                                       // pop rdi
-		0x48, 0x83, 0xec, 0x28,                                     // sub rsp, 40
+		0x48, 0x83, 0xec, 0x20,                                     // sub rsp, 32
 		0x48, 0xb8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // mov rax, old_panic
 		0xff, 0xd0,                                                 // call rax
-		0x48, 0x83, 0xc4, 0x28,                                     // add rsp, 40
+		0x48, 0x83, 0xc4, 0x20,                                     // add rsp, 32
 		0x58,                                                       // pop rax
 		0xc3,                                                       // ret
 	};
 	std::unique_ptr<thunk> t(new thunk);
-	if (!shellcode_create(t.get(), sizeof(sc))) {
+	if (!t->create(sizeof(sc))) {
 		return 0;
 	}
 	memcpy(sc + 11, &dbg, sizeof(dbg));
@@ -1,25 +1,38 @@
 #include <Windows.h>
 
-bool thunk::create(size_t s) {
-	data = VirtualAllocEx(GetCurrentProcess(), NULL, s, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
-	if (!data) {
-		size = 0;
+static bool thunk_map(size_t size, char*& exec, char*& view) {
+	HANDLE h = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_EXECUTE_READWRITE, 0, (DWORD)size, NULL);
+	if (!h) {
 		return false;
 	}
-	size = s;
-	return true;
-}
-
-bool thunk::write(void* buf) {
-	SIZE_T written = 0;
-	BOOL ok = WriteProcessMemory(GetCurrentProcess(), data, buf, size, &written);
-	if (!ok || written != size) {
+	void* v = MapViewOfFile(h, FILE_MAP_WRITE, 0, 0, size);
+	void* e = MapViewOfFile(h, FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, size);
+	CloseHandle(h);
+	if (!v || !e) {
+		if (v) UnmapViewOfFile(v);
+		if (e) UnmapViewOfFile(e);
 		return false;
 	}
+	exec = (char*)e;
+	view = (char*)v;
 	return true;
 }
 
-thunk::~thunk() {
-	if (!data) return;
-	VirtualFreeEx(GetCurrentProcess(), data, 0, MEM_RELEASE);
+static void* thunk_alloc_private(size_t size) {
+	return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+static bool thunk_seal(void* data, size_t size) {
+	DWORD old = 0;
+	return !!VirtualProtect(data, size, PAGE_EXECUTE_READ, &old);
 }
+
+static void thunk_free_private(void* data, size_t size) {
+	VirtualFree(data, 0, MEM_RELEASE);
+}
+
+static void thunk_flush(void* data, size_t size) {
+	FlushInstructionCache(GetCurrentProcess(), data, size);
+}
+
+#include "thunk_arena.inl"
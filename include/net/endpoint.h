@@ -9,8 +9,10 @@
 #	include <sys/socket.h>
 #	include <netinet/in.h>
 #	include <arpa/inet.h>
+#	include <sys/un.h>
 #	include <netdb.h>
 #	include <memory.h>
+#	include <stddef.h>
 #endif
 
 namespace net {
@@ -19,12 +21,18 @@ namespace net {
 	public:
 		endpoint()
 		{
-			memset(&addr_, 0, sizeof(struct sockaddr_in));
+			memset(&addr_, 0, sizeof(addr_));
 		}
 
 		endpoint(const std::string& addr)
 		{
-			memset(&addr_, 0, sizeof(struct sockaddr_in));
+			memset(&addr_, 0, sizeof(addr_));
+#if !defined _WIN32
+			if (addr.compare(0, 5, "unix:") == 0) {
+				local(addr.substr(5));
+				return;
+			}
+#endif
 			size_t pos = addr.find(':');
 			if (pos == addr.npos) {
 				address(addr);
@@ -34,39 +42,44 @@ namespace net {
 				address(addr.substr(0, pos));
 				port(atoi(addr.substr(pos + 1).c_str()));
 			}
-			addr_.sin_family = AF_INET;
+			addr_.in.sin_family = AF_INET;
 		}
 
 		endpoint(const std::string& hostname, uint16_t port_num)
 		{
-			memset(&addr_, 0, sizeof(struct sockaddr_in));
+			memset(&addr_, 0, sizeof(addr_));
 			address(hostname);
 			port(port_num);
-			addr_.sin_family = AF_INET;
+			addr_.in.sin_family = AF_INET;
 		}
 
 		endpoint(uint32_t ip, uint16_t port_num)
 		{
-			memset(&addr_, 0, sizeof(struct sockaddr_in));
+			memset(&addr_, 0, sizeof(addr_));
 			address(ip);
 			port(port_num);
-			addr_.sin_family = AF_INET;
+			addr_.in.sin_family = AF_INET;
 		}
 
 		std::string to_string() const
 		{
+#if !defined _WIN32
+			if (family() == AF_UNIX) {
+				return "unix:" + path();
+			}
+#endif
 			char result[32] = { 0 };
 #if defined(_WIN32)
 			sprintf_s(result, sizeof(result) - 1, "%d.%d.%d.%d:%d"
-				, addr_.sin_addr.S_un.S_un_b.s_b1
-				, addr_.sin_addr.S_un.S_un_b.s_b2
-				, addr_.sin_addr.S_un.S_un_b.s_b3
-				, addr_.sin_addr.S_un.S_un_b.s_b4
+				, addr_.in.sin_addr.S_un.S_un_b.s_b1
+				, addr_.in.sin_addr.S_un.S_un_b.s_b2
+				, addr_.in.sin_addr.S_un.S_un_b.s_b3
+				, addr_.in.sin_addr.S_un.S_un_b.s_b4
 				, port()
 			);
 #else
 			char ip_str[32] = { 0 };
-			::inet_ntop(addr_.sin_family, &(addr_.sin_addr), ip_str, sizeof(ip_str));
+			::inet_ntop(addr_.in.sin_family, &(addr_.in.sin_addr), ip_str, sizeof(ip_str));
 			sprintf(result, "%s:%d", ip_str, port());
 #endif
 			return std::move(std::string(result));
@@ -77,48 +90,48 @@ namespace net {
 			char result[32] = { 0 };
 #if defined(_WIN32)
 			sprintf_s(result, sizeof(result) - 1, "%d.%d.%d.%d"
-				, addr_.sin_addr.S_un.S_un_b.s_b1
-				, addr_.sin_addr.S_un.S_un_b.s_b2
-				, addr_.sin_addr.S_un.S_un_b.s_b3
-				, addr_.sin_addr.S_un.S_un_b.s_b4
+				, addr_.in.sin_addr.S_un.S_un_b.s_b1
+				, addr_.in.sin_addr.S_un.S_un_b.s_b2
+				, addr_.in.sin_addr.S_un.S_un_b.s_b3
+				, addr_.in.sin_addr.S_un.S_un_b.s_b4
 			);
 #else
-			::inet_ntop(addr_.sin_family, &(addr_.sin_addr), result, sizeof(result));
+			::inet_ntop(addr_.in.sin_family, &(addr_.in.sin_addr), result, sizeof(result));
 #endif
 			return std::move(std::string(result));
 		}
 
 		void port(uint16_t port_num)
 		{
-			addr_.sin_port = htons(port_num);
+			addr_.in.sin_port = htons(port_num);
 		}
 
 		uint16_t port() const
 		{
-			return ntohs(addr_.sin_port);
+			return ntohs(addr_.in.sin_port);
 		}
 
 		void address(uint32_t ip)
 		{
-			addr_.sin_addr.s_addr = htonl(ip);
+			addr_.in.sin_addr.s_addr = htonl(ip);
 		}
 
 		void address(const std::string& hostname)
 		{
-			addr_.sin_addr.s_addr = inet_addr(hostname.c_str());
-			if (addr_.sin_addr.s_addr == (uint32_t)-1)
+			addr_.in.sin_addr.s_addr = inet_addr(hostname.c_str());
+			if (addr_.in.sin_addr.s_addr == (uint32_t)-1)
 			{
 				hostent* hostptr = gethostbyname(hostname.c_str());
 				if (hostptr) 
 				{
-					addr_.sin_addr.s_addr = (*reinterpret_cast<uint32_t*>(hostptr->h_addr_list[0]));
+					addr_.in.sin_addr.s_addr = (*reinterpret_cast<uint32_t*>(hostptr->h_addr_list[0]));
 				}
 			}
 		}
 
 		uint32_t address() const
 		{
-			return ntohl(addr_.sin_addr.s_addr);
+			return ntohl(addr_.in.sin_addr.s_addr);
 		}
 
 		const struct sockaddr* addr() const
@@ -133,17 +146,63 @@ namespace net {
 
 		size_t addrlen() const
 		{
+#if !defined _WIN32
+			if (family() == AF_UNIX) {
+				return unlen_;
+			}
+#endif
 			return sizeof(sockaddr_in);
 		}
 
+		int family() const
+		{
+			return addr_.in.sin_family;
+		}
+
+		void assign(const struct sockaddr* sa, size_t len)
+		{
+			memset(&addr_, 0, sizeof(addr_));
+			if (len > sizeof(addr_)) len = sizeof(addr_);
+			memcpy(&addr_, sa, len);
+#if !defined _WIN32
+			unlen_ = len;
+#endif
+		}
+
+#if !defined _WIN32
+		// Filesystem path of an AF_UNIX endpoint; names in the abstract
+		// namespace are returned with a leading '@'.
+		std::string path() const
+		{
+			size_t base = offsetof(struct sockaddr_un, sun_path);
+			if (unlen_ <= base) {
+				return std::string();
+			}
+			if (addr_.un.sun_path[0] == '\0') {
+				return "@" + std::string(addr_.un.sun_path + 1, unlen_ - base - 1);
+			}
+			return std::string(addr_.un.sun_path, strnlen(addr_.un.sun_path, unlen_ - base));
+		}
+
+		bool valid() const
+		{
+			return family() != AF_UNIX || unlen_ > offsetof(struct sockaddr_un, sun_path);
+		}
+
+		bool abstract() const
+		{
+			return family() == AF_UNIX && unlen_ > offsetof(struct sockaddr_un, sun_path) && addr_.un.sun_path[0] == '\0';
+		}
+#endif
+
 	public:
 		template <class Reader>
 		void parse(Reader& r)
 		{
-			memset(&addr_, 0, sizeof(struct sockaddr_in));
+			memset(&addr_, 0, sizeof(addr_));
 			uint32_t i32 = 0; r.pop(i32); address(i32);
 			uint16_t i16 = 0; r.pop(i16); port(i16);
-			addr_.sin_family = AF_INET;
+			addr_.in.sin_family = AF_INET;
 		}
 
 		template <class Writer>
@@ -154,6 +213,37 @@ namespace net {
 		}
 
 	private:
-		sockaddr_in addr_;
+#if !defined _WIN32
+		// A name that does not fit in sun_path leaves the endpoint invalid
+		// rather than truncated, which would name a different file.
+		void local(const std::string& name)
+		{
+			addr_.un.sun_family = AF_UNIX;
+			size_t n = name.size();
+			if (n >= sizeof(addr_.un.sun_path)) {
+				unlen_ = 0;
+				return;
+			}
+			memcpy(addr_.un.sun_path, name.data(), n);
+			if (n > 0 && name[0] == '@') {
+				addr_.un.sun_path[0] = '\0';
+				unlen_ = offsetof(struct sockaddr_un, sun_path) + n;
+			}
+			else {
+				unlen_ = offsetof(struct sockaddr_un, sun_path) + n + 1;
+			}
+		}
+#endif
+
+	private:
+		union {
+			sockaddr_in in;
+#if !defined _WIN32
+			sockaddr_un un;
+#endif
+		} addr_;
+#if !defined _WIN32
+		size_t unlen_ = 0;
+#endif
 	};
 }
@@ -10,6 +10,8 @@ namespace net {
 #if defined _WIN32
 	struct poller_t : public poller::select_t { };
 #else						  
-	struct poller_t : public poller::epoll_t { };
+	struct poller_t : public poller::epoll_t {
+		poller_t(trigger mode = trigger::edge) : epoll_t(mode) { }
+	};
 #endif
 }
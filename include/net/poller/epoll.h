@@ -4,6 +4,8 @@
 #include <net/poller/event.h>
 #include <net/poller/timer_queue.h>
 #include <sys/epoll.h>
+#include <algorithm>
+#include <vector>
 
 namespace net { namespace poller {
 
@@ -11,15 +13,40 @@ namespace net { namespace poller {
 		: public timer_queue
 	{
 	public:
+		enum class trigger {
+			level,
+			edge,
+		};
+
 		struct ud_t
 		{
+			event_t* e;
+			// interest
 			bool read;
 			bool write;
+			// level: events registered in the kernel
+			// edge:  readiness reported by the kernel and not yet drained
+			unsigned events;
+			bool readable;
+			bool writable;
+			bool pending;
 		};
 
-		epoll_t()
+		// Poller syscalls issued so far; recv/send on the sockets are not counted.
+		struct syscalls_t
+		{
+			uint64_t ctl;
+			uint64_t wait;
+		};
+
+		epoll_t(trigger mode = trigger::edge)
 			: timer_queue()
 			, epfd_(epoll_create(1024))
+			, mode_(mode)
+			, events_()
+			, pending_()
+			, running_(nullptr)
+			, syscalls_()
 		{
 			assert(epfd_ != -1);
 		}
@@ -29,21 +56,45 @@ namespace net { namespace poller {
 			close(epfd_);
 		}
 
+		bool edge_triggered() const
+		{
+			return mode_ == trigger::edge;
+		}
+
+		const syscalls_t& syscalls() const
+		{
+			return syscalls_;
+		}
+
 		void add_fd(socket::fd_t s, event_t* e, ud_t* ud)
 		{
+			ud->e = e;
 			ud->read = false;
 			ud->write = false;
-			
+			ud->readable = false;
+			ud->writable = false;
+			ud->pending = false;
+
 			struct epoll_event ev;
-			ev.events = 0;
-			ev.data.ptr = e;
+			ev.events = edge_triggered() ? (EPOLLIN | EPOLLOUT | EPOLLET) : 0;
+			ev.data.ptr = ud;
+			ud->events = ev.events;
+			syscalls_.ctl++;
 			int rc = epoll_ctl(epfd_, EPOLL_CTL_ADD, s, &ev);
 			assert(rc != -1); (unsigned)rc;
 		}
-		
+
 		void rm_fd(event_t* e, ud_t* ud)
 		{
+			syscalls_.ctl++;
 			epoll_ctl(epfd_, EPOLL_CTL_DEL, e->sock, NULL);
+			if (ud->pending) {
+				ud->pending = false;
+				pending_.erase(std::remove(pending_.begin(), pending_.end(), ud), pending_.end());
+			}
+			if (running_) {
+				std::replace(running_->begin(), running_->end(), ud, (ud_t*)nullptr);
+			}
 		}
 
 		void set_pollin(event_t* e, ud_t* ud)
@@ -72,15 +123,42 @@ namespace net { namespace poller {
 			update(e, ud);
 		}
 
+		void clear_readable(event_t* e, ud_t* ud)
+		{
+			ud->readable = false;
+		}
+
+		void clear_writable(event_t* e, ud_t* ud)
+		{
+			ud->writable = false;
+		}
+
 		void update(event_t* e, ud_t* ud)
 		{
+			if (edge_triggered())
+			{
+				// The registration never changes; if the kernel already reported
+				// readiness that we have not consumed, no new edge will arrive.
+				if (((ud->read && ud->readable) || (ud->write && ud->writable)) && !ud->pending)
+				{
+					ud->pending = true;
+					pending_.push_back(ud);
+				}
+				return;
+			}
+
+			unsigned events = 0;
+			if (ud->read) events |= EPOLLIN;
+			if (ud->write) events |= EPOLLOUT;
+			if (events == ud->events) return;
+
 			struct epoll_event ev;
-			ev.events = 0;
-			if (ud->read) ev.events |= EPOLLIN;
-			if (ud->write) ev.events |= EPOLLOUT;
-			ev.data.ptr = e;
+			ev.events = events;
+			ev.data.ptr = ud;
+			syscalls_.ctl++;
 			int rc = epoll_ctl(epfd_, EPOLL_CTL_MOD, e->sock, &ev);
 			assert(rc != -1); (unsigned)rc;
+			ud->events = events;
 		}
 
 		int wait(size_t maxn, int timeout)
@@ -88,39 +166,88 @@ namespace net { namespace poller {
 			int64_t next = timer_queue::execute_timers();
 			timeout = (timeout > next) ? next : timeout;
 
-			struct epoll_event ev[maxn];
-			int n = epoll_wait(epfd_, ev, maxn, timeout);
+			if (!pending_.empty())
+			{
+				run_pending();
+				if (!pending_.empty()) timeout = 0;
+			}
+
+			if (events_.size() < maxn)
+			{
+				events_.resize(maxn);
+			}
+			syscalls_.wait++;
+			int n = epoll_wait(epfd_, events_.data(), (int)maxn, timeout);
 			for (int i = 0; i < n; ++i)
 			{
-				event_t* e = (event_t*)ev[i].data.ptr;
-				unsigned flag = ev[i].events;
-				if ((flag & EPOLLOUT) != 0)
+				ud_t* ud = (ud_t*)events_[i].data.ptr;
+				event_t* e = ud->e;
+				unsigned flag = events_[i].events;
+				if (edge_triggered())
+				{
+					if (flag & (EPOLLERR | EPOLLHUP)) flag |= EPOLLIN | EPOLLOUT;
+					if (flag & EPOLLOUT) ud->writable = true;
+					if (flag & EPOLLIN)  ud->readable = true;
+					if (!ud->write) flag &= ~EPOLLOUT;
+					if (!ud->read)  flag &= ~EPOLLIN;
+				}
+				dispatch(e, flag);
+			}
+			return n;
+		}
+
+	private:
+		bool dispatch(event_t* e, unsigned flag)
+		{
+			if ((flag & EPOLLOUT) != 0)
+			{
+				if (e->sock != socket::retired_fd)
 				{
-					if (e->sock != socket::retired_fd)
+					if (!e->event_out() && e->sock != socket::retired_fd)
 					{
-						if (!e->event_out() && e->sock != socket::retired_fd)
-						{
-							e->event_close();
-							continue;
-						}
+						e->event_close();
+						return false;
 					}
 				}
-				if ((flag & EPOLLIN) != 0)
+			}
+			if ((flag & EPOLLIN) != 0)
+			{
+				if (e->sock != socket::retired_fd)
 				{
-					if (e->sock != socket::retired_fd)
+					if (!e->event_in() && e->sock != socket::retired_fd)
 					{
-						if (!e->event_in() && e->sock != socket::retired_fd)
-						{
-							e->event_close();
-							continue;
-						}
+						e->event_close();
+						return false;
 					}
 				}
 			}
-			return n;
+			return true;
+		}
+
+		void run_pending()
+		{
+			std::vector<ud_t*> pending;
+			pending.swap(pending_);
+			running_ = &pending;
+			for (size_t i = 0; i < pending.size(); ++i)
+			{
+				ud_t* ud = pending[i];
+				if (!ud) continue;
+				ud->pending = false;
+				unsigned flag = 0;
+				if (ud->write && ud->writable) flag |= EPOLLOUT;
+				if (ud->read && ud->readable)  flag |= EPOLLIN;
+				dispatch(ud->e, flag);
+			}
+			running_ = nullptr;
 		}
 
 	private:
-		int epfd_;
+		int                        epfd_;
+		trigger                    mode_;
+		std::vector<epoll_event>   events_;
+		std::vector<ud_t*>         pending_;
+		std::vector<ud_t*>*        running_;
+		syscalls_t                 syscalls_;
 	};
 }}
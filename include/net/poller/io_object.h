@@ -60,6 +60,21 @@ namespace net { namespace poller {
 			poller_->reset_pollout(event_, &ud_);
 		}
 
+		bool edge_triggered() const
+		{
+			return poller_->edge_triggered();
+		}
+
+		void clear_readable()
+		{
+			poller_->clear_readable(event_, &ud_);
+		}
+
+		void clear_writable()
+		{
+			poller_->clear_writable(event_, &ud_);
+		}
+
 		void add_timer(int timeout, uint64_t id)
 		{
 			poller_->add_timer(timeout, event_, id);
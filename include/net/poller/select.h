@@ -98,6 +98,17 @@ namespace net { namespace poller {
 			assert(false);
 		}
 
+		bool edge_triggered() const
+		{
+			return false;
+		}
+
+		void clear_readable(event_t* /*e*/, ud_t* /*ud*/)
+		{ }
+
+		void clear_writable(event_t* /*e*/, ud_t* /*ud*/)
+		{ }
+
 		int wait(size_t maxn, int timeout)
 		{
 			int64_t next = timer_queue::execute_timers();
@@ -46,6 +46,9 @@ namespace net { namespace socket {
 	int  bind(fd_t s, const endpoint& ep);
 	int  listen(fd_t s, const endpoint& ep, int backlog);
 	int  accept(fd_t s, fd_t& sock, endpoint& ep);
+#if !defined _WIN32
+	bool peer_uid(fd_t s, uid_t& uid);
+#endif
 	int  error_no();
 }}
 
@@ -283,6 +283,13 @@ namespace net { namespace socket {
 
 	NET_INLINE int connect(fd_t s, const endpoint& ep)
 	{
+#if !defined _WIN32
+		if (!ep.valid())
+		{
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+#endif
 		int rc = ::connect(s, ep.addr(), (int)ep.addrlen());
 		if (rc == 0)
 			return 0;
@@ -300,6 +307,13 @@ namespace net { namespace socket {
 
 	NET_INLINE int bind(fd_t s, const endpoint& ep)
 	{
+#if !defined _WIN32
+		if (!ep.valid())
+		{
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+#endif
 		return ::bind(s, ep.addr(), (int)ep.addrlen());
 	}
 
@@ -341,8 +355,24 @@ namespace net { namespace socket {
 #if defined _WIN32
 		assert(ss_len > 0);
 #endif
-		assert((size_t)ss_len >= ep.addrlen());
-		memcpy(ep.addr(), &ss, ep.addrlen());
+		ep.assign((struct sockaddr *) &ss, (size_t)ss_len);
 		return 0;
 	}
+
+#if !defined _WIN32
+	NET_INLINE bool peer_uid(fd_t s, uid_t& uid)
+	{
+#if defined __linux__
+		struct ucred cred;
+		socklen_t len = sizeof(cred);
+		if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1)
+			return false;
+		uid = cred.uid;
+		return true;
+#else
+		gid_t gid;
+		return getpeereid(s, &uid, &gid) == 0;
+#endif
+	}
+#endif
 }}
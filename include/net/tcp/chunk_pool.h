@@ -0,0 +1,248 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace net { namespace tcp {
+
+	struct chunk_pool_stats
+	{
+		size_t pooled;
+		size_t outstanding;
+		size_t peak;
+		size_t limit;
+	};
+
+	// Free list of fixed-size chunks. Each thread keeps a short list of its
+	// own, so allocate/deallocate normally never lock; past `batch * 2`
+	// chunks the surplus moves in one go to a shared depot, from which any
+	// thread refills an empty list. Chunks freed on another thread (the
+	// network thread releasing what the Lua thread allocated) thus find
+	// their way back. `limit` caps the chunks held by all threads together;
+	// anything beyond it goes back to the heap.
+	template <class Chunk>
+	class chunk_pool
+	{
+	public:
+		static Chunk* allocate()
+		{
+			size_t n = outstanding_.fetch_add(1, std::memory_order_relaxed) + 1;
+			size_t peak = peak_.load(std::memory_order_relaxed);
+			while (n > peak && !peak_.compare_exchange_weak(peak, n, std::memory_order_relaxed))
+			{ }
+			if (retired())
+			{
+				return static_cast<Chunk*>(::operator new(sizeof(Chunk)));
+			}
+			return local().get();
+		}
+
+		static void deallocate(Chunk* p)
+		{
+			outstanding_.fetch_sub(1, std::memory_order_relaxed);
+			if (retired() || !reserve())
+			{
+				::operator delete(p);
+				return;
+			}
+			local().put(p);
+		}
+
+		static void set_limit(size_t limit)
+		{
+			limit_.store(limit, std::memory_order_relaxed);
+		}
+
+		static chunk_pool_stats stats()
+		{
+			chunk_pool_stats s;
+			s.pooled = pooled_.load(std::memory_order_relaxed);
+			s.outstanding = outstanding_.load(std::memory_order_relaxed);
+			s.peak = peak_.load(std::memory_order_relaxed);
+			s.limit = limit_.load(std::memory_order_relaxed);
+			return s;
+		}
+
+	private:
+		enum { batch = 16 };
+
+		struct node
+		{
+			node* next;
+		};
+		static_assert(sizeof(Chunk) >= sizeof(node), "chunk too small");
+
+		struct depot
+		{
+			std::mutex mtx;
+			node*      free = nullptr;
+		};
+
+		chunk_pool()
+			: free_(nullptr)
+			, size_(0)
+		{ }
+
+		~chunk_pool()
+		{
+			retired() = true;
+			release(free_);
+		}
+
+		static chunk_pool& local()
+		{
+			static thread_local chunk_pool pool;
+			return pool;
+		}
+
+		// Never destroyed: threads may still return chunks during exit.
+		static depot& shared()
+		{
+			static depot* d = new depot;
+			return *d;
+		}
+
+		// Buffers owned by static objects may outlive this thread's pool.
+		static bool& retired()
+		{
+			static thread_local bool v = false;
+			return v;
+		}
+
+		// Claims one of the `limit` pooled slots shared by all threads.
+		static bool reserve()
+		{
+			size_t n = pooled_.load(std::memory_order_relaxed);
+			do
+			{
+				if (n >= limit_.load(std::memory_order_relaxed))
+				{
+					return false;
+				}
+			} while (!pooled_.compare_exchange_weak(n, n + 1, std::memory_order_relaxed));
+			return true;
+		}
+
+		static void release(node* p)
+		{
+			while (p)
+			{
+				node* next = p->next;
+				::operator delete(p);
+				pooled_.fetch_sub(1, std::memory_order_relaxed);
+				p = next;
+			}
+		}
+
+		Chunk* get()
+		{
+			if (!free_)
+			{
+				refill();
+				if (!free_)
+				{
+					return static_cast<Chunk*>(::operator new(sizeof(Chunk)));
+				}
+			}
+			node* p = free_;
+			free_ = p->next;
+			size_--;
+			pooled_.fetch_sub(1, std::memory_order_relaxed);
+			return reinterpret_cast<Chunk*>(p);
+		}
+
+		void put(Chunk* p)
+		{
+			node* n = reinterpret_cast<node*>(p);
+			n->next = free_;
+			free_ = n;
+			size_++;
+			if (size_ > batch * 2)
+			{
+				flush();
+			}
+		}
+
+		void refill()
+		{
+			depot& d = shared();
+			std::lock_guard<std::mutex> lock(d.mtx);
+			for (size_t i = 0; i < batch && d.free; ++i)
+			{
+				node* p = d.free;
+				d.free = p->next;
+				p->next = free_;
+				free_ = p;
+				size_++;
+			}
+		}
+
+		void flush()
+		{
+			node* head = free_;
+			node* tail = head;
+			for (size_t i = 1; i < batch; ++i)
+			{
+				tail = tail->next;
+			}
+			free_ = tail->next;
+			size_ -= batch;
+			depot& d = shared();
+			std::lock_guard<std::mutex> lock(d.mtx);
+			tail->next = d.free;
+			d.free = head;
+		}
+
+		chunk_pool(const chunk_pool&);
+		chunk_pool& operator=(const chunk_pool&);
+
+	private:
+		node*  free_;
+		size_t size_;
+
+		static std::atomic<size_t> pooled_;
+		static std::atomic<size_t> outstanding_;
+		static std::atomic<size_t> peak_;
+		static std::atomic<size_t> limit_;
+	};
+
+	template <class Chunk> std::atomic<size_t> chunk_pool<Chunk>::pooled_(0);
+	template <class Chunk> std::atomic<size_t> chunk_pool<Chunk>::outstanding_(0);
+	template <class Chunk> std::atomic<size_t> chunk_pool<Chunk>::peak_(0);
+	template <class Chunk> std::atomic<size_t> chunk_pool<Chunk>::limit_(256);
+
+	// Allocator for buffer_alloc: single-chunk requests go through chunk_pool,
+	// anything else falls back to std::allocator.
+	template <class T>
+	class pool_allocator
+		: public ::std::allocator<T>
+	{
+	public:
+		template <class U>
+		struct rebind
+		{
+			typedef pool_allocator<U> other;
+		};
+
+		T* allocate(size_t n)
+		{
+			if (n == 1)
+			{
+				return chunk_pool<T>::allocate();
+			}
+			return ::std::allocator<T>::allocate(n);
+		}
+
+		void deallocate(T* p, size_t n)
+		{
+			if (n == 1)
+			{
+				chunk_pool<T>::deallocate(p);
+				return;
+			}
+			::std::allocator<T>::deallocate(p, n);
+		}
+	};
+}}
@@ -40,11 +40,11 @@ namespace net { namespace tcp {
 			close();
 		}
 
-		int open()
+		int open(int family = AF_INET)
 		{
 			close();
 
-			event_type::sock = socket::open(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			event_type::sock = socket::open(family, SOCK_STREAM, family == AF_INET ? IPPROTO_TCP : 0);
 
 			if (event_type::sock == socket::retired_fd)
 			{
@@ -93,21 +93,32 @@ namespace net { namespace tcp {
 
 		bool event_in()
 		{
-			socket::fd_t fd = socket::retired_fd;
-			endpoint ep;
-			int rc = socket::accept(event_type::sock, fd, ep);
-			if (rc == 0)
-			{
-				event_accept(fd, ep);
-				return true;
-			}
-			else if (rc == -2)
-			{
-				return true;
-			}
-			else
+			for (;;)
 			{
-				return false;
+				socket::fd_t fd = socket::retired_fd;
+				endpoint ep;
+				int rc = socket::accept(event_type::sock, fd, ep);
+				if (rc == 0)
+				{
+					event_accept(fd, ep);
+					if (!base_t::edge_triggered() || event_type::sock == socket::retired_fd)
+					{
+						return true;
+					}
+				}
+				else if (rc == -2)
+				{
+					int ec = socket::error_no();
+					if (ec == EAGAIN || ec == EWOULDBLOCK || !base_t::edge_triggered())
+					{
+						base_t::clear_readable();
+						return true;
+					}
+				}
+				else
+				{
+					return false;
+				}
 			}
 		}
 
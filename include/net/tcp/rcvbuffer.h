@@ -1,6 +1,7 @@
 #pragma once
 
 #include <net/tcp/buffer.h>
+#include <net/tcp/chunk_pool.h>
 
 namespace net { namespace tcp {
 
@@ -105,7 +106,7 @@ namespace net { namespace tcp {
 		}
 
 	private:
-		buffer<char, 4096> rcvbuf_;
+		buffer<char, 4096, pool_allocator<char>> rcvbuf_;
 		size_t length_;
 	};
 }}
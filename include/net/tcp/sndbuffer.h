@@ -1,6 +1,7 @@
 #pragma once
 
 #include <net/tcp/buffer.h>
+#include <net/tcp/chunk_pool.h>
 
 namespace net { namespace tcp {
 
@@ -65,7 +66,10 @@ namespace net { namespace tcp {
 		}
 
 	private:
-		buffer<char, 4096> sndbuf_;
+		buffer<char, 4096, pool_allocator<char>> sndbuf_;
 		size_t length_;
 	};
+
+	// The pool shared by every sndbuffer and rcvbuffer.
+	typedef chunk_pool<buffer_chunk<char, 4096>> stream_chunk_pool;
 }}
@@ -40,6 +40,7 @@ namespace net { namespace tcp {
 			NETLOG_INFO() << "socket(" << s << ") " << ep.to_string() << " connected";
 			event_type::sock = s;
 			remote_ = ep;
+			socket::nonblocking(event_type::sock);
 			base_t::set_fd(event_type::sock);
 			base_t::set_pollin();
 			if (!write_empty())
@@ -105,6 +106,11 @@ namespace net { namespace tcp {
 			return sndbuf_.empty();
 		}
 
+		size_t send_size() const
+		{
+			return sndbuf_.size();
+		}
+
 		size_t recv(char* buf, size_t buflen)
 		{
 			return rcvbuf_.pop(buf, buflen);
@@ -122,59 +128,71 @@ namespace net { namespace tcp {
 
 		bool event_in()
 		{
-			int rc = ::recv(event_type::sock, rcvbuf_.rcv_data(), (int)rcvbuf_.rcv_size(), 0);
-			if (rc == 0)
+			for (;;)
 			{
-				NETLOG_ERROR() << "socket(" << event_type::sock << ") recv error, ec = " << socket::error_no_();
-				return false;
-			}
-			else if (rc < 0)
-			{
-				int ec = socket::error_no();
-				if (ec == EAGAIN || ec == EWOULDBLOCK || ec == EINTR)
-				{
-					return true;
-				}
-				else
+				int rc = ::recv(event_type::sock, rcvbuf_.rcv_data(), (int)rcvbuf_.rcv_size(), 0);
+				if (rc == 0)
 				{
 					NETLOG_ERROR() << "socket(" << event_type::sock << ") recv error, ec = " << socket::error_no_();
 					return false;
 				}
-			}
+				else if (rc < 0)
+				{
+					int ec = socket::error_no();
+					if (ec == EAGAIN || ec == EWOULDBLOCK)
+					{
+						base_t::clear_readable();
+						return true;
+					}
+					else if (ec == EINTR)
+					{
+						if (base_t::edge_triggered()) continue;
+						return true;
+					}
+					else
+					{
+						NETLOG_ERROR() << "socket(" << event_type::sock << ") recv error, ec = " << socket::error_no_();
+						return false;
+					}
+				}
 
-			rcvbuf_.rcv_push(rc);
-			return true;
+				rcvbuf_.rcv_push(rc);
+				// edge triggered pollers only report new data, so drain until EAGAIN
+				if (!base_t::edge_triggered())
+				{
+					return true;
+				}
+			}
 		}
 
 		bool event_out()
 		{
-			if (sndbuf_.empty())
+			while (!sndbuf_.empty())
 			{
-				if (wait_close_) force_close();
-				return true;
-			}
-
-			int rc = ::send(event_type::sock, sndbuf_.snd_data(), (int)sndbuf_.snd_size(), 0);
-			if (rc < 0)
-			{
-				int ec = socket::error_no();
-				if (ec == EAGAIN || ec == EWOULDBLOCK || ec == EINTR)
-				{
-					return true;
-				}
-				else
+				int rc = ::send(event_type::sock, sndbuf_.snd_data(), (int)sndbuf_.snd_size(), 0);
+				if (rc < 0)
 				{
-					NETLOG_ERROR() << "socket(" << event_type::sock << ") send error, ec = " << socket::error_no_();
-					return false;
+					int ec = socket::error_no();
+					if (ec == EAGAIN || ec == EWOULDBLOCK)
+					{
+						base_t::clear_writable();
+						return true;
+					}
+					else if (ec == EINTR)
+					{
+						continue;
+					}
+					else
+					{
+						NETLOG_ERROR() << "socket(" << event_type::sock << ") send error, ec = " << socket::error_no_();
+						return false;
+					}
 				}
+				sndbuf_.snd_pop(rc);
 			}
 
-			sndbuf_.snd_pop(rc);
-			if (write_empty())
-			{
-				base_t::reset_pollout();
-				if (wait_close_) force_close();
-			}
+			base_t::reset_pollout();
+			if (wait_close_) force_close();
 			return true;
 		}
 
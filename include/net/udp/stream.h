@@ -31,26 +31,41 @@ namespace net { namespace udp {
 
 		bool event_in()
 		{
-			std::unique_ptr<recvbuf_t> rbuff(new recvbuf_t);
-			memset(rbuff->data(), 0, sizeof(*rbuff));
-			endpoint remote;
+			for (;;)
+			{
+				std::unique_ptr<recvbuf_t> rbuff(new recvbuf_t);
+				memset(rbuff->data(), 0, sizeof(*rbuff));
+				endpoint remote;
 #if defined _WIN32
-			int len = (int)remote.addrlen();
+				int len = (int)remote.addrlen();
 #else
-			socklen_t len = remote.addrlen();
+				socklen_t len = remote.addrlen();
 #endif
-			int rc = recvfrom(event_type::sock, rbuff->data() + 2, (int)(rbuff->size() - 12), 0, remote.addr(), &len);
-			if (rc > 0)
-			{
-				*(uint16_t*)rbuff->data() = (uint16_t)rc;
-				*(uint32_t*)(rbuff->data()+1502) = remote.address();
-				event_recv(rbuff.release());
-			}
-			else
-			{
-				NETLOG_ERROR()<< " recvfrom error. the errno is  " << socket::error_no();
+				int rc = recvfrom(event_type::sock, rbuff->data() + 2, (int)(rbuff->size() - 12), 0, remote.addr(), &len);
+				if (rc > 0)
+				{
+					*(uint16_t*)rbuff->data() = (uint16_t)rc;
+					*(uint32_t*)(rbuff->data()+1502) = remote.address();
+					event_recv(rbuff.release());
+					if (base_type::edge_triggered())
+					{
+						continue;
+					}
+				}
+				else
+				{
+					int ec = socket::error_no();
+					if (ec == EAGAIN || ec == EWOULDBLOCK)
+					{
+						base_type::clear_readable();
+					}
+					else
+					{
+						NETLOG_ERROR()<< " recvfrom error. the errno is  " << ec;
+					}
+				}
+				return true;
 			}
-			return true;
 		}
 
 		int32_t send(const char* sbuff, int len, const endpoint &ep)
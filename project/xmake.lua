@@ -21,3 +21,4 @@ end
 includes 'xmake/lua53.lua'
 includes 'xmake/lua54.lua'
 includes 'xmake/debugger.lua'
+includes 'xmake/bench.lua'
@@ -0,0 +1,94 @@
+local src = root .. "src/debugger/"
+target("debugger-bench")
+    set_kind("binary")
+    set_default(false)
+    add_deps("lua54-dll")
+    set_languages("cxx17")
+    add_cxxflags("-DRAPIDJSON_HAS_STDSTRING", "-DDEBUGGER_INLINE")
+    if is_plat("windows") then
+        add_cxxflags("-EHsc", "-DLUA_BUILD_AS_DLL", "-D_WIN32_WINNT=0x0600")
+        add_links("ws2_32")
+    elseif is_plat("mingw") then
+        add_cxxflags("-DLUA_BUILD_AS_DLL", "-D_WIN32_WINNT=0x0600")
+        add_links("ws2_32")
+    else
+        add_links("pthread")
+        if is_plat("linux") then
+            add_links("rt")
+        end
+    end
+    add_includedirs(root .. "include/")
+    add_includedirs(root .. "third_party/")
+    add_includedirs(root .. "third_party/lua54/")
+    add_includedirs(root .. "third_party/readerwriterqueue/")
+    add_files(src .. "*.cpp")
+    add_files(src .. "io/*.cpp")
+    add_files(src .. "bridge/luaopen.cpp")
+    add_files(src .. "bench/main.cpp")
+    add_files(root .. "include/debugger/thunk/thunk.cpp")
+target_end()
+
+target("debugger-replay")
+    set_kind("binary")
+    set_default(false)
+    set_languages("cxx17")
+    add_cxxflags("-DRAPIDJSON_HAS_STDSTRING", "-DDEBUGGER_INLINE")
+    if is_plat("windows") then
+        add_cxxflags("-EHsc", "-D_WIN32_WINNT=0x0600")
+        add_links("ws2_32")
+    elseif is_plat("mingw") then
+        add_cxxflags("-D_WIN32_WINNT=0x0600")
+        add_links("ws2_32")
+    else
+        add_links("pthread")
+    end
+    add_includedirs(root .. "include/")
+    add_includedirs(root .. "third_party/")
+    add_includedirs(root .. "third_party/readerwriterqueue/")
+    add_files(src .. "replay/main.cpp")
+    add_files(src .. "io/socket.cpp")
+    add_files(src .. "io/stream.cpp")
+    add_files(src .. "io/lz4.cpp")
+    add_files(src .. "io/recorder.cpp")
+target_end()
+
+target("debugger-hashbench")
+    set_kind("binary")
+    set_default(false)
+    set_languages("cxx17")
+    if is_plat("windows") then
+        add_cxxflags("-EHsc")
+    end
+    add_includedirs(root .. "include/")
+    add_includedirs(root .. "third_party/")
+    add_files(src .. "bench/crc.cpp")
+    add_files(src .. "crc32.cpp")
+target_end()
+
+target("debugger-netbench")
+    set_kind("binary")
+    set_default(false)
+    set_languages("cxx17")
+    add_cxxflags("-DRAPIDJSON_HAS_STDSTRING", "-DDEBUGGER_INLINE")
+    if is_plat("windows") then
+        add_cxxflags("-EHsc", "-D_WIN32_WINNT=0x0600")
+        add_links("ws2_32")
+    elseif is_plat("mingw") then
+        add_cxxflags("-D_WIN32_WINNT=0x0600")
+        add_links("ws2_32")
+    else
+        add_links("pthread")
+        if is_plat("linux") then
+            add_links("rt")
+        end
+    end
+    add_includedirs(root .. "include/")
+    add_includedirs(root .. "third_party/")
+    add_includedirs(root .. "third_party/readerwriterqueue/")
+    add_files(src .. "bench/net.cpp")
+    add_files(src .. "io/socket.cpp")
+    add_files(src .. "io/stream.cpp")
+    add_files(src .. "io/lz4.cpp")
+    add_files(src .. "io/shm.cpp")
+    add_files(src .. "io/recorder.cpp")
+target_end()
@@ -28,6 +28,9 @@ target("debugger")
         add_links("ws2_32")
     else
         add_links("pthread")
+        if is_plat("linux") then
+            add_links("rt")
+        end
     end
     add_includedirs(root .. "include/")
     add_includedirs(root .. "third_party/")
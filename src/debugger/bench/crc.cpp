@@ -0,0 +1,142 @@
+#include <debugger/crc32.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Throughput of every CRC kernel this machine supports, and a check that
+// each one agrees with the byte-at-a-time table on the same input.
+
+using vscode::crc::kernel;
+
+static const kernel kernels[] = {
+	kernel::table,
+	kernel::slice8,
+	kernel::sse42,
+	kernel::pclmul,
+};
+
+static const size_t sizes[] = {
+	64,
+	256,
+	1024,
+	4 * 1024,
+	64 * 1024,
+	1024 * 1024,
+	16 * 1024 * 1024,
+	64 * 1024 * 1024,
+};
+
+static uint32_t compute(kernel k, bool c, const unsigned char* buf, size_t len)
+{
+	return c ? vscode::crc::crc32c(k, buf, len) : vscode::crc::crc32(k, buf, len);
+}
+
+// Every length up to 300 at every misalignment up to 16, so each kernel's
+// head, body and tail paths are exercised.
+static bool verify(kernel k, bool c, const std::vector<unsigned char>& data)
+{
+	for (size_t off = 0; off < 16; ++off) {
+		for (size_t len = 0; len <= 300; ++len) {
+			if (compute(k, c, &data[off], len) != compute(kernel::table, c, &data[off], len)) {
+				fprintf(stderr, "%s %s: mismatch at offset %d, length %d\n", c ? "crc32c" : "crc32", vscode::crc::name(k), (int)off, (int)len);
+				return false;
+			}
+		}
+	}
+	size_t len = data.size() - 16;
+	return compute(k, c, &data[16], len) == compute(kernel::table, c, &data[16], len);
+}
+
+// Best of `repeat` runs, each hashing at least 64 MB in total.
+static double throughput(kernel k, bool c, const unsigned char* buf, size_t len, int repeat)
+{
+	size_t rounds = std::max<size_t>(1, (64 * 1024 * 1024) / len);
+	double best = 0;
+	volatile uint32_t sink = 0;
+	for (int r = 0; r < repeat; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < rounds; ++i) {
+			sink = sink + compute(k, c, buf, len);
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		double gbps = ns > 0 ? (double)(len * rounds) / ns : 0;
+		best = std::max(best, gbps);
+	}
+	return best;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: debugger-hashbench [--repeat <n>] [--max <bytes>]\n");
+	exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	int repeat = 3;
+	size_t max = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+	for (int i = 1; i < argc; ++i) {
+		if (i + 1 >= argc) usage();
+		if (strcmp(argv[i], "--repeat") == 0) repeat = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--max") == 0) max = (size_t)atoll(argv[++i]);
+		else usage();
+	}
+
+	std::vector<unsigned char> data(max + 16);
+	uint32_t seed = 0x9E3779B9;
+	for (auto& b : data) {
+		seed = seed * 1664525 + 1013904223;
+		b = (unsigned char)(seed >> 24);
+	}
+
+	bool ok = true;
+	rapidjson::StringBuffer sb;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> res(sb);
+	res.StartObject();
+	for (bool c : { false, true }) {
+		res.Key(c ? "crc32c" : "crc32");
+		res.StartObject();
+		res.Key("selected");
+		res.String(vscode::crc::name(vscode::crc::selected(c)));
+		res.Key("kernels");
+		res.StartArray();
+		for (kernel k : kernels) {
+			if (!vscode::crc::supported(k, c)) {
+				continue;
+			}
+			bool match = verify(k, c, data);
+			ok = ok && match;
+			res.StartObject();
+			res.Key("name");
+			res.String(vscode::crc::name(k));
+			res.Key("match");
+			res.Bool(match);
+			res.Key("gbps");
+			res.StartArray();
+			for (size_t len : sizes) {
+				if (len > max) {
+					break;
+				}
+				res.StartObject();
+				res.Key("bytes");
+				res.Uint64(len);
+				res.Key("value");
+				res.Double(throughput(k, c, &data[0], len, repeat));
+				res.EndObject();
+			}
+			res.EndArray();
+			res.EndObject();
+		}
+		res.EndArray();
+		res.EndObject();
+	}
+	res.EndObject();
+	puts(sb.GetString());
+	return ok ? 0 : 1;
+}
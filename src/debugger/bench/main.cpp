@@ -0,0 +1,771 @@
+#include <debugger/debugger.h>
+#include <debugger/io/base.h>
+#include <debugger/lua.h>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <base/util/format.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Measures the cost of the debugger hook path. Every workload is run on a
+// fresh lua_State under each mode; the debugger is driven through an
+// in-memory io::base that plays the client and answers stopped events by
+// itself, so the numbers contain no socket or client latency.
+
+struct memio : public vscode::io::base
+{
+	enum class policy {
+		resume,
+		step,
+		threads,
+	};
+
+	void update(int ms)
+	{
+	}
+
+	bool output(const char* buf, size_t len)
+	{
+		rapidjson::Document d;
+		if (d.Parse(buf, len).HasParseError()) {
+			return true;
+		}
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (d["type"] == "response") {
+			responses_.insert(d["request_seq"].GetInt64());
+			if (d["command"] == "threads" && d.HasMember("body")) {
+				auto& threads = d["body"]["threads"];
+				threads_.listed = threads.Size();
+				threads_.first = threads.Empty() ? 0 : threads[0]["id"].GetInt();
+				threads_.total = d["body"]["totalThreads"].GetUint64();
+			}
+		}
+		else if (d["type"] == "event" && d["event"] == "stopped") {
+			int threadId = d["body"]["threadId"].GetInt();
+			stops_++;
+			if (policy_ == policy::threads) {
+				push("threads", R"({"start":0,"count":100})");
+			}
+			push(policy_ == policy::step ? "stepIn" : "continue", ::base::format(R"({"threadId":%d})", threadId));
+		}
+		return true;
+	}
+
+	bool input(std::string& buf)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (input_.empty()) {
+			return false;
+		}
+		buf = std::move(input_.front());
+		input_.pop_front();
+		return true;
+	}
+
+	void close()
+	{
+	}
+
+	// Sends a request and waits for the debugger thread to answer it.
+	void request(const char* command, const std::string& args)
+	{
+		int64_t seq;
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			seq = push(command, args);
+		}
+		for (;;) {
+			{
+				std::lock_guard<std::mutex> lock(mtx_);
+				if (responses_.count(seq)) {
+					return;
+				}
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	void set_policy(policy p)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		policy_ = p;
+	}
+
+	uint64_t stops()
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		return stops_;
+	}
+
+	struct threads_page {
+		size_t   listed = 0;
+		int      first = 0;
+		uint64_t total = 0;
+	};
+
+	threads_page threads()
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		return threads_;
+	}
+
+private:
+	int64_t push(const char* command, const std::string& args)
+	{
+		int64_t seq = seq_++;
+		input_.push_back(::base::format(R"({"type":"request","seq":%d,"command":"%s","arguments":%s})", seq, command, args));
+		return seq;
+	}
+
+	std::mutex              mtx_;
+	std::deque<std::string> input_;
+	std::set<int64_t>       responses_;
+	policy                  policy_ = policy::resume;
+	int64_t                 seq_ = 1;
+	uint64_t                stops_ = 0;
+	threads_page            threads_;
+};
+
+// A client that stops reading while `stalled`: everything the debugger
+// sends piles up in send_size(), and each update lets `drain` bytes through.
+struct stallio : public memio
+{
+	struct result {
+		size_t   peak = 0;
+		uint64_t messages = 0;
+		uint64_t bytes = 0;
+		uint64_t printed = 0;
+		uint64_t dropped = 0;
+		uint64_t coalesced = 0;
+	};
+
+	void update(int ms)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		backlog_ -= std::min(backlog_, drain_);
+	}
+
+	bool output(const char* buf, size_t len)
+	{
+		static const char stdout_event[] = R"("category":"stdout")";
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (std::search(buf, buf + len, stdout_event, stdout_event + sizeof(stdout_event) - 1) != buf + len) {
+				result_.printed++;
+			}
+			if (stalled_) {
+				backlog_ += len;
+				result_.peak = std::max(result_.peak, backlog_);
+				result_.messages++;
+				result_.bytes += len;
+				return true;
+			}
+		}
+		rapidjson::Document d;
+		if (!d.Parse(buf, len).HasParseError() && d["type"] == "response" && d["command"] == "debuggerStats") {
+			std::lock_guard<std::mutex> lock(mtx_);
+			auto& output = d["body"]["output"];
+			result_.dropped = output["droppedMessages"].GetUint64();
+			result_.coalesced = output["coalescedBytes"].GetUint64();
+		}
+		return memio::output(buf, len);
+	}
+
+	size_t send_size()
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		return backlog_;
+	}
+
+	void stall(bool stalled, size_t drain)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		stalled_ = stalled;
+		drain_ = drain;
+		backlog_ = 0;
+	}
+
+	result get()
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		return result_;
+	}
+
+private:
+	std::mutex mtx_;
+	bool       stalled_ = false;
+	size_t     drain_ = 0;
+	size_t     backlog_ = 0;
+	result     result_;
+};
+
+// Line 2 of every workload is inside `hot`; the driver loop starts at
+// `entry_line`. The chunk receives the iteration count as its argument.
+struct workload {
+	const char* name;
+	int         iterations;
+	int         entry_line;
+	const char* code;
+};
+
+static const workload workloads[] = {
+	{ "fib", 20, 5, R"(local function hot(n)
+	if n < 2 then return n end
+	return hot(n - 1) + hot(n - 2)
+end
+local N = ...
+local sum = 0
+for i = 1, N do
+	sum = sum + hot(15)
+end
+return sum
+)" },
+	{ "table_churn", 20000, 6, R"(local function hot(i)
+	local t = { i, i + 1, x = i, y = tostring(i) }
+	t[#t + 1] = t.x
+	return t
+end
+local N = ...
+local keep = {}
+for i = 1, N do
+	keep[i % 64 + 1] = hot(i)
+end
+)" },
+	{ "string_build", 20000, 10, R"(local function hot(parts, i)
+	parts[#parts + 1] = ("%d:%s"):format(i, "x")
+	if #parts >= 256 then
+		local s = table.concat(parts, ",")
+		for k = #parts, 1, -1 do parts[k] = nil end
+		return #s
+	end
+	return 0
+end
+local N = ...
+local parts, total = {}, 0
+for i = 1, N do
+	total = total + hot(parts, i)
+end
+return total
+)" },
+	{ "coroutine_pingpong", 20000, 5, R"(local function hot(co, i)
+	local _, v = coroutine.resume(co, i)
+	return v
+end
+local N = ...
+local co = coroutine.create(function(v)
+	while true do
+		v = coroutine.yield(v + 1)
+	end
+end)
+local sum = 0
+for i = 1, N do
+	sum = sum + hot(co, i)
+end
+return sum
+)" },
+	{ "deep_recursion", 200, 5, R"(local function hot(n)
+	if n == 0 then return 0 end
+	return 1 + hot(n - 1)
+end
+local N = ...
+local sum = 0
+for i = 1, N do
+	sum = sum + hot(150)
+end
+return sum
+)" },
+};
+
+enum class mode {
+	none,
+	idle,
+	unrelated,
+	hot,
+	conditional,
+	logpoint,
+	stepping,
+};
+
+static const char* mode_name(mode m)
+{
+	switch (m) {
+	case mode::none: return "none";
+	case mode::idle: return "idle";
+	case mode::unrelated: return "unrelated_breakpoints";
+	case mode::hot: return "hot_breakpoint";
+	case mode::conditional: return "conditional_breakpoint";
+	case mode::logpoint: return "logpoint";
+	case mode::stepping: return "stepping";
+	}
+	return "?";
+}
+
+static const mode modes[] = {
+	mode::none,
+	mode::idle,
+	mode::unrelated,
+	mode::hot,
+	mode::conditional,
+	mode::logpoint,
+	mode::stepping,
+};
+
+static std::string chunkpath(const workload& w)
+{
+	return base::format("/bench/%s.lua", w.name);
+}
+
+static std::string breakpoints(const std::string& path, const std::string& list)
+{
+	return base::format(R"({"source":{"path":"%s"},"breakpoints":[%s]})", path, list);
+}
+
+static void count_line(lua_State* L, lua_Debug* ar)
+{
+	lua_getfield(L, LUA_REGISTRYINDEX, "bench.lines");
+	lua_Integer n = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	lua_pushinteger(L, n + 1);
+	lua_setfield(L, LUA_REGISTRYINDEX, "bench.lines");
+}
+
+// Runs one workload on a fresh state and returns the elapsed nanoseconds of
+// the chunk itself, or -1 if it raised an error.
+static int64_t run(vscode::debugger* dbg, const workload& w, int iterations, uint64_t* lines = nullptr)
+{
+	lua_State* L = luaL_newstate();
+	luaL_openlibs(L);
+	std::string chunkname = "@" + chunkpath(w);
+	if (luaL_loadbuffer(L, w.code, strlen(w.code), chunkname.c_str()) != LUA_OK) {
+		fprintf(stderr, "%s: %s\n", w.name, lua_tostring(L, -1));
+		lua_close(L);
+		return -1;
+	}
+	lua_pushinteger(L, iterations);
+	if (dbg) {
+		dbg->attach_lua(L);
+	}
+	if (lines) {
+		lua_sethook(L, count_line, LUA_MASKLINE, 0);
+	}
+	auto start = std::chrono::steady_clock::now();
+	int status = lua_pcall(L, 1, 0, 0);
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	if (status != LUA_OK) {
+		fprintf(stderr, "%s: %s\n", w.name, lua_tostring(L, -1));
+	}
+	if (lines) {
+		lua_getfield(L, LUA_REGISTRYINDEX, "bench.lines");
+		*lines = (uint64_t)lua_tointeger(L, -1);
+		lua_pop(L, 1);
+	}
+	if (dbg) {
+		dbg->detach_lua(L, true);
+	}
+	lua_close(L);
+	if (status != LUA_OK) {
+		return -1;
+	}
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+static void configure(memio& io, const workload& w, mode m)
+{
+	std::string own = chunkpath(w);
+	std::string other = "/bench/unrelated.lua";
+	std::string list;
+	switch (m) {
+	case mode::unrelated:
+		for (int line = 1; line <= 32; ++line) {
+			list += base::format(R"(%s{"line":%d})", line == 1 ? "" : ",", line);
+		}
+		io.request("setBreakpoints", breakpoints(other, list));
+		io.request("setBreakpoints", breakpoints(own, ""));
+		break;
+	case mode::hot:
+		io.request("setBreakpoints", breakpoints(other, ""));
+		io.request("setBreakpoints", breakpoints(own, R"({"line":2})"));
+		break;
+	case mode::conditional:
+		io.request("setBreakpoints", breakpoints(other, ""));
+		io.request("setBreakpoints", breakpoints(own, R"({"line":2,"condition":"__bench_never"})"));
+		break;
+	case mode::logpoint:
+		io.request("setBreakpoints", breakpoints(other, ""));
+		io.request("setBreakpoints", breakpoints(own, R"({"line":2,"logMessage":"hot"})"));
+		break;
+	case mode::stepping:
+		io.request("setBreakpoints", breakpoints(other, ""));
+		io.request("setBreakpoints", breakpoints(own, base::format(R"({"line":%d})", w.entry_line)));
+		break;
+	default:
+		io.request("setBreakpoints", breakpoints(other, ""));
+		io.request("setBreakpoints", breakpoints(own, ""));
+		break;
+	}
+	io.set_policy(m == mode::stepping ? memio::policy::step : memio::policy::resume);
+}
+
+static int64_t since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Attaches `n` lua_States at once, looks each of them up from its main
+// thread and from a coroutine, stops one of them to page through the
+// threads, and detaches them all. Returns false if any step misbehaves.
+template <class Writer>
+static bool stress_states(vscode::debugger& dbg, memio& io, int n, Writer& res)
+{
+	std::vector<lua_State*> states(n);
+	std::vector<lua_State*> coroutines(n);
+	for (int i = 0; i < n; ++i) {
+		states[i] = luaL_newstate();
+		coroutines[i] = lua_newthread(states[i]);  // kept on the stack
+	}
+	bool ok = true;
+
+	auto start = std::chrono::steady_clock::now();
+	for (lua_State* L : states) {
+		ok = dbg.attach_lua(L) && ok;
+	}
+	int64_t attach = since(start);
+
+	start = std::chrono::steady_clock::now();
+	for (lua_State* L : states) {
+		ok = dbg.exception(L, vscode::eException::pcall, 0) && ok;
+	}
+	int64_t lookup = since(start);
+
+	start = std::chrono::steady_clock::now();
+	for (lua_State* L : coroutines) {
+		ok = dbg.exception(L, vscode::eException::pcall, 0) && ok;
+	}
+	int64_t lookup_coroutine = since(start);
+
+	lua_State* stopped = states[n / 2];
+	io.set_policy(memio::policy::threads);
+	io.request("pause", base::format(R"({"threadId":%d})", n / 2 + 1));
+	luaL_loadstring(stopped, "local x = 1\nreturn x\n");
+	lua_pcall(stopped, 0, 0, 0);
+	io.set_policy(memio::policy::resume);
+	memio::threads_page page = io.threads();
+	ok = ok && page.listed == (size_t)std::min(n, 100) && page.total == (uint64_t)n && page.first == n / 2 + 1;
+
+	start = std::chrono::steady_clock::now();
+	for (lua_State* L : states) {
+		dbg.detach_lua(L, true);
+	}
+	int64_t detach = since(start);
+	ok = ok && !dbg.exception(states[0], vscode::eException::pcall, 0);
+
+	for (lua_State* L : states) {
+		lua_close(L);
+	}
+
+	res.Key("states");
+	res.StartObject();
+	res.Key("count");
+	res.Int(n);
+	res.Key("attach_ns");
+	res.Double((double)attach / n);
+	res.Key("lookup_ns");
+	res.Double((double)lookup / n);
+	res.Key("lookup_coroutine_ns");
+	res.Double((double)lookup_coroutine / n);
+	res.Key("detach_ns");
+	res.Double((double)detach / n);
+	res.Key("threads_listed");
+	res.Uint64(page.listed);
+	res.Key("threads_total");
+	res.Uint64(page.total);
+	res.Key("ok");
+	res.Bool(ok);
+	res.EndObject();
+	return ok;
+}
+
+// Runs `w` on 1, 2, 4, ... up to `max` OS threads at once, each on its own
+// lua_State, with breakpoints set in another file only, once detached and
+// once attached. Attached states that never stop should scale like the
+// detached ones.
+template <class Writer>
+static void scale_threads(vscode::debugger& dbg, memio& io, const workload& w, int iterations, int repeat, int max, Writer& res)
+{
+	configure(io, w, mode::unrelated);
+	auto wall = [&](vscode::debugger* d, int n) {
+		int64_t best = -1;
+		for (int r = 0; r < repeat; ++r) {
+			std::vector<std::thread> threads;
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < n; ++i) {
+				threads.emplace_back([&]() { run(d, w, iterations); });
+			}
+			for (auto& t : threads) {
+				t.join();
+			}
+			int64_t ns = since(start);
+			if (best < 0 || ns < best) {
+				best = ns;
+			}
+		}
+		return best;
+	};
+	res.Key("name");
+	res.String(w.name);
+	res.Key("iterations");
+	res.Int(iterations);
+	res.Key("threads");
+	res.StartArray();
+	std::vector<int> counts;
+	for (int n = 1; n < max; n *= 2) {
+		counts.push_back(n);
+	}
+	counts.push_back(max);
+	int64_t single = 0;
+	for (int n : counts) {
+		int64_t none = wall(nullptr, n);
+		int64_t attached = wall(&dbg, n);
+		if (n == 1) {
+			single = attached;
+		}
+		res.StartObject();
+		res.Key("threads");
+		res.Int(n);
+		res.Key("none_ns");
+		res.Int64(none);
+		res.Key("ns");
+		res.Int64(attached);
+		res.Key("slowdown");
+		res.Double(none > 0 ? (double)attached / none : 0.0);
+		res.Key("scaling");
+		res.Double(single > 0 ? (double)attached / single : 0.0);
+		res.EndObject();
+	}
+	res.EndArray();
+}
+
+// Prints `lines` lines through the redirected print while the client is
+// stalled, once per outputPolicy. The send queue must stay near `limit`
+// whatever the policy; block must also deliver every line.
+template <class Writer>
+static bool stress_stall(int lines, size_t limit, Writer& res)
+{
+	static const char* policies[] = { "drop", "coalesce", "block" };
+	static const char* code = R"(local N = ...
+local line = ("x"):rep(100)
+for i = 1, N do
+	print(line, i)
+end
+)";
+	bool ok = true;
+	res.Key("stall");
+	res.StartObject();
+	res.Key("lines");
+	res.Int(lines);
+	res.Key("limit");
+	res.Uint64(limit);
+	res.Key("policies");
+	res.StartArray();
+	for (const char* policy : policies) {
+		stallio io;
+		vscode::debugger dbg(&io);
+		io.request("initialize", R"({"adapterID":"lua"})");
+		io.request("attach", base::format(R"({"stopOnEntry":false,"consoleCoding":"utf8","sourceCoding":"utf8","outputLimit":%d,"outputPolicy":"%s","outputMergeWindow":0,"outputRate":0})", (int)limit, policy));
+		io.request("configurationDone", "{}");
+
+		lua_State* L = luaL_newstate();
+		luaL_openlibs(L);
+		luaL_loadbuffer(L, code, strlen(code), "=stall");
+		lua_pushinteger(L, lines);
+		dbg.attach_lua(L);
+		dbg.open_redirect(vscode::eRedirect::print, L);
+		io.stall(true, 64 * 1024);
+		auto start = std::chrono::steady_clock::now();
+		int status = lua_pcall(L, 1, 0, 0);
+		int64_t ns = since(start);
+		// Let the debugger thread catch up with what is still queued.
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		io.stall(false, 0);
+		io.request("debuggerStats", "{}");
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		dbg.detach_lua(L, true);
+		lua_close(L);
+
+		stallio::result r = io.get();
+		// coalesce may send what it held back (up to limit) on top of a queue
+		// that has just dropped under the limit.
+		size_t bound = strcmp(policy, "coalesce") == 0 ? limit * 2 : limit;
+		bool bounded = r.peak <= bound + 64 * 1024;
+		bool complete = strcmp(policy, "block") != 0 || (r.dropped == 0 && r.printed == (uint64_t)lines);
+		ok = ok && status == LUA_OK && bounded && complete;
+		res.StartObject();
+		res.Key("policy");
+		res.String(policy);
+		res.Key("ns");
+		res.Int64(ns);
+		res.Key("peak_send_queue");
+		res.Uint64(r.peak);
+		res.Key("messages_sent");
+		res.Uint64(r.messages);
+		res.Key("bytes_sent");
+		res.Uint64(r.bytes);
+		res.Key("printed_messages");
+		res.Uint64(r.printed);
+		res.Key("dropped_messages");
+		res.Uint64(r.dropped);
+		res.Key("coalesced_bytes");
+		res.Uint64(r.coalesced);
+		res.Key("ok");
+		res.Bool(status == LUA_OK && bounded && complete);
+		res.EndObject();
+	}
+	res.EndArray();
+	res.EndObject();
+	return ok;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: debugger-bench [--scale <factor>] [--repeat <n>] [--workload <name>] [--states <n>] [--threads <max>] [--stall <lines>]\n");
+	exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	double scale = 1.0;
+	int repeat = 3;
+	const char* only = nullptr;
+	int states = 0;
+	int threads = 0;
+	int stall = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (i + 1 >= argc) usage();
+		if (strcmp(argv[i], "--scale") == 0) scale = atof(argv[++i]);
+		else if (strcmp(argv[i], "--repeat") == 0) repeat = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--workload") == 0) only = argv[++i];
+		else if (strcmp(argv[i], "--states") == 0) states = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--threads") == 0) threads = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--stall") == 0) stall = std::max(1, atoi(argv[++i]));
+		else usage();
+	}
+
+	if (stall) {
+		rapidjson::StringBuffer sb;
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> res(sb);
+		res.StartObject();
+		bool ok = stress_stall(stall, 1024 * 1024, res);
+		res.EndObject();
+		puts(sb.GetString());
+		fflush(stdout);
+		return ok ? 0 : 1;
+	}
+
+	memio io;
+	vscode::debugger dbg(&io);
+	io.request("initialize", R"({"adapterID":"lua"})");
+	io.request("attach", R"({"stopOnEntry":false,"consoleCoding":"utf8","sourceCoding":"utf8"})");
+	io.request("configurationDone", "{}");
+
+	rapidjson::StringBuffer sb;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> res(sb);
+	res.StartObject();
+	res.Key("lua");
+	res.String(LUA_RELEASE);
+	res.Key("scale");
+	res.Double(scale);
+	res.Key("repeat");
+	res.Int(repeat);
+	if (states) {
+		bool ok = stress_states(dbg, io, states, res);
+		res.EndObject();
+		puts(sb.GetString());
+		fflush(stdout);
+		return ok ? 0 : 1;
+	}
+	if (threads) {
+		const workload* w = &workloads[0];
+		for (auto& x : workloads) {
+			if (only && strcmp(only, x.name) == 0) {
+				w = &x;
+			}
+		}
+		scale_threads(dbg, io, *w, std::max(1, (int)(w->iterations * scale)), repeat, threads, res);
+		res.EndObject();
+		puts(sb.GetString());
+		fflush(stdout);
+		return 0;
+	}
+	res.Key("workloads");
+	res.StartArray();
+	for (auto& w : workloads) {
+		if (only && strcmp(only, w.name) != 0) {
+			continue;
+		}
+		int iterations = std::max(1, (int)(w.iterations * scale));
+		uint64_t lines = 0;
+		run(nullptr, w, iterations, &lines);
+
+		res.StartObject();
+		res.Key("name");
+		res.String(w.name);
+		res.Key("iterations");
+		res.Int(iterations);
+		res.Key("line_events");
+		res.Uint64(lines);
+		res.Key("modes");
+		res.StartArray();
+		int64_t baseline = 0;
+		for (mode m : modes) {
+			configure(io, w, m);
+			int64_t best = -1;
+			uint64_t stops = io.stops();
+			for (int r = 0; r < repeat; ++r) {
+				int64_t ns = run(m == mode::none ? nullptr : &dbg, w, iterations);
+				if (ns >= 0 && (best < 0 || ns < best)) {
+					best = ns;
+				}
+			}
+			stops = (io.stops() - stops) / repeat;
+			if (m == mode::none) {
+				baseline = best;
+			}
+			if (m == mode::stepping) {
+				// Leave stepping: the next attached line stops once and resumes.
+				io.set_policy(memio::policy::resume);
+				configure(io, w, mode::idle);
+				static const workload settle = { "settle", 1, 1, "local x = ...\n" };
+				run(&dbg, settle, 1);
+			}
+			res.StartObject();
+			res.Key("mode");
+			res.String(mode_name(m));
+			res.Key("ns");
+			res.Int64(best);
+			res.Key("ns_per_line");
+			res.Double(lines ? (double)best / lines : 0.0);
+			res.Key("slowdown");
+			res.Double(baseline > 0 ? (double)best / baseline : 0.0);
+			res.Key("stops");
+			res.Uint64(stops);
+			res.EndObject();
+		}
+		res.EndArray();
+		res.EndObject();
+	}
+	res.EndArray();
+	res.EndObject();
+	puts(sb.GetString());
+	fflush(stdout);
+	return 0;
+}
@@ -0,0 +1,582 @@
+#define NETLOG_BACKEND NETLOG_EMPTY_BACKEND
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <net/poller.h>
+#include <net/tcp/connecter.h>
+#include <net/tcp/listener.h>
+#include <net/tcp/stream.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <debugger/io/socket.h>
+#include <debugger/io/shm.h>
+#include <debugger/io/recorder.h>
+#include <debugger/cbor.h>
+#include <rapidjson/writer.h>
+#include <map>
+#include <math.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+// Transport benchmarks, one mode per run:
+//   epoll  loopback flood through net::poller_t, counting epoll_ctl and
+//          epoll_wait calls in level and edge triggered mode.
+//   latency  request/response round trips through io::socket_c and
+//          io::socket_s, over loopback TCP and over a unix domain socket.
+//   throughput  one-way bulk transfer from the debuggee side to the client
+//          side over TCP, a unix domain socket and io::shm.
+//   cbor   size and encode/decode time of every message of a session
+//          recorded with dbg:record(), as JSON and as CBOR.
+
+typedef rapidjson::PrettyWriter<rapidjson::StringBuffer> json_writer;
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return (double)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1000.0;
+}
+
+#if !defined(_WIN32)
+
+// Accepts one connection and discards everything it receives.
+class flood_sink
+	: public net::tcp::listener
+{
+	class session
+		: public net::tcp::stream
+	{
+	public:
+		session(net::poller_t* poll, size_t& received)
+			: net::tcp::stream(poll)
+			, received_(received)
+		{ }
+
+		bool event_in()
+		{
+			if (!net::tcp::stream::event_in())
+				return false;
+			received_ += recv(recv_size());
+			return true;
+		}
+
+	private:
+		size_t& received_;
+	};
+
+public:
+	flood_sink(net::poller_t* poll)
+		: net::tcp::listener(poll)
+		, session_()
+		, received(0)
+	{ }
+
+	~flood_sink()
+	{
+		if (session_)
+			session_->force_close();
+	}
+
+	void event_accept(net::socket::fd_t fd, const net::endpoint& ep)
+	{
+		session_.reset(new session(get_poller(), received));
+		session_->attach(fd, ep);
+	}
+
+	uint16_t port() const
+	{
+		sockaddr_in addr;
+		socklen_t addrlen = sizeof(addr);
+		::getsockname(sock, (sockaddr*)&addr, &addrlen);
+		return ntohs(addr.sin_port);
+	}
+
+private:
+	std::unique_ptr<session> session_;
+
+public:
+	size_t received;
+};
+
+struct flood_result
+{
+	uint64_t ctl;
+	uint64_t wait;
+	double   ms;
+};
+
+// The sender behaves like the debugger's update loop: queue a batch of
+// event-sized messages, then poll without blocking.
+static flood_result flood(net::poller_t::trigger mode, size_t total, size_t msgsize, size_t batch)
+{
+	net::poller_t poller(mode);
+	flood_sink sink(&poller);
+	sink.open(AF_INET);
+	sink.listen(net::endpoint("127.0.0.1", 0));
+	net::tcp::connecter sender(&poller);
+	sender.connect(net::endpoint("127.0.0.1", sink.port()));
+
+	std::string msg(msgsize, 'x');
+	size_t sent = 0;
+	net::poller_t::syscalls_t base = poller.syscalls();
+	auto start = std::chrono::steady_clock::now();
+	while (sink.received < total) {
+		if (sender.sock != net::socket::retired_fd) {
+			for (size_t i = 0; i < batch && sent < total && sender.send_size() < 256 * 1024; ++i) {
+				sent += sender.send(msg.data(), std::min(msgsize, total - sent));
+			}
+		}
+		poller.wait(1000, sent < total ? 0 : 10);
+	}
+	flood_result r;
+	r.ms = elapsed_ms(start);
+	r.ctl = poller.syscalls().ctl - base.ctl;
+	r.wait = poller.syscalls().wait - base.wait;
+	sender.force_close();
+	return r;
+}
+
+static void bench_epoll(json_writer& res, size_t total, int repeat)
+{
+	static const size_t msgsizes[] = { 128, 1024, 16 * 1024 };
+	res.Key("bytes");
+	res.Uint64(total);
+	res.Key("floods");
+	res.StartArray();
+	for (size_t msgsize : msgsizes) {
+		res.StartObject();
+		res.Key("message");
+		res.Uint64(msgsize);
+		for (auto mode : { net::poller_t::trigger::level, net::poller_t::trigger::edge }) {
+			flood_result best = { 0, 0, 0 };
+			for (int i = 0; i < repeat; ++i) {
+				flood_result r = flood(mode, total, msgsize, 16);
+				if (i == 0 || r.ms < best.ms) best = r;
+			}
+			res.Key(mode == net::poller_t::trigger::edge ? "edge" : "level");
+			res.StartObject();
+			res.Key("epoll_ctl");
+			res.Uint64(best.ctl);
+			res.Key("epoll_wait");
+			res.Uint64(best.wait);
+			res.Key("ms");
+			res.Double(best.ms);
+			res.EndObject();
+		}
+		res.EndObject();
+	}
+	res.EndArray();
+}
+
+#endif
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double q)
+{
+	size_t rank = (size_t)ceil(q * sorted.size());
+	return sorted[rank ? rank - 1 : 0];
+}
+
+// Runs `serve` on its own thread until `stop`, the way the debuggee's
+// network thread would.
+template <class Server>
+static std::thread echo_thread(Server& server, std::atomic<bool>& stop)
+{
+	return std::thread([&]() {
+		std::string buf;
+		while (!stop) {
+			server.update(1);
+			while (server.input(buf)) {
+				server.output(buf.data(), buf.size());
+			}
+		}
+	});
+}
+
+template <class Client>
+static bool wait_connected(Client& client)
+{
+	auto start = std::chrono::steady_clock::now();
+	while (client.is_closed()) {
+		if (elapsed_ms(start) > 5000) {
+			return false;
+		}
+		client.update(10);
+	}
+	return true;
+}
+
+// Round trip of one message, in microseconds.
+template <class Client>
+static uint64_t round_trip(Client& client, const std::string& msg, std::string& buf)
+{
+	auto start = std::chrono::steady_clock::now();
+	client.output(msg.data(), msg.size());
+	for (;;) {
+		client.update(1);
+		if (client.input(buf)) {
+			break;
+		}
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+static bool bench_latency_one(json_writer& res, const char* name, const std::string& addr, size_t count)
+{
+	static const size_t msgsizes[] = { 64, 1024, 64 * 1024 };
+	vscode::io::socket_s server(addr.c_str());
+	vscode::io::socket_c client(addr.c_str());
+	std::atomic<bool> stop(false);
+	std::thread t = echo_thread(server, stop);
+	bool ok = wait_connected(client);
+	if (ok) {
+		res.Key(name);
+		res.StartArray();
+		std::string buf;
+		for (size_t msgsize : msgsizes) {
+			std::string msg(msgsize, 'x');
+			// Large messages over TCP can stall on delayed ACKs; keep the run short.
+			size_t n = msgsize > 4096 ? std::max<size_t>(1, count / 10) : count;
+			for (size_t i = 0; i < n / 10; ++i) {
+				round_trip(client, msg, buf);
+			}
+			std::vector<uint64_t> us;
+			for (size_t i = 0; i < n; ++i) {
+				us.push_back(round_trip(client, msg, buf));
+			}
+			std::sort(us.begin(), us.end());
+			res.StartObject();
+			res.Key("message");
+			res.Uint64(msgsize);
+			res.Key("p50_us");
+			res.Uint64(percentile(us, 0.5));
+			res.Key("p99_us");
+			res.Uint64(percentile(us, 0.99));
+			res.EndObject();
+		}
+		res.EndArray();
+	}
+	stop = true;
+	t.join();
+	return ok;
+}
+
+static bool bench_latency(json_writer& res, size_t count)
+{
+	res.Key("roundTrips");
+	res.Uint64(count);
+	bool ok = bench_latency_one(res, "tcp", "127.0.0.1:43781", count);
+#if !defined(_WIN32)
+	std::string path = "/tmp/debugger-netbench-" + std::to_string(getpid()) + ".sock";
+	ok = bench_latency_one(res, "unix", "unix:" + path, count) && ok;
+#endif
+	return ok;
+}
+
+// Printable, poorly compressible payload, closer to a variables response
+// than a run of one byte.
+static std::string payload(size_t n)
+{
+	std::string s(n, ' ');
+	uint32_t seed = 0x9E3779B9;
+	for (auto& c : s) {
+		seed = seed * 1664525 + 1013904223;
+		c = (char)(' ' + (seed >> 24) % 95);
+	}
+	return s;
+}
+
+// The debuggee side sends `total` bytes in `msgsize` messages from its own
+// thread, never queueing more than 1 MB; the client side reads on this one.
+// Returns MB/s, or a negative value if the transport never connected.
+template <class Server, class Client>
+static double transfer(Server& server, Client& client, size_t total, size_t msgsize)
+{
+	std::atomic<bool> stop(false);
+	std::atomic<bool> connected(false);
+	std::string msg = payload(msgsize);
+	std::thread t([&]() {
+		while (!stop && server.is_closed()) {
+			server.update(1);
+		}
+		connected = true;
+		size_t sent = 0;
+		while (!stop) {
+			while (sent < total && server.send_size() < 1024 * 1024) {
+				server.output(msg.data(), msg.size());
+				sent += msg.size();
+			}
+			server.update(sent < total ? 0 : 1);
+		}
+	});
+	double mbps = -1;
+	auto start = std::chrono::steady_clock::now();
+	while (!connected || client.is_closed()) {
+		if (elapsed_ms(start) > 5000) {
+			break;
+		}
+		client.update(1);
+	}
+	if (connected && !client.is_closed()) {
+		std::string buf;
+		size_t received = 0;
+		start = std::chrono::steady_clock::now();
+		while (received < total && elapsed_ms(start) < 60000) {
+			client.update(1);
+			while (client.input(buf)) {
+				received += buf.size();
+			}
+		}
+		double ms = elapsed_ms(start);
+		if (received >= total && ms > 0) {
+			mbps = (double)received / (1024 * 1024) / (ms / 1000);
+		}
+	}
+	stop = true;
+	t.join();
+	return mbps;
+}
+
+static double throughput_socket(const std::string& addr, size_t total, size_t msgsize)
+{
+	vscode::io::socket_s server(addr.c_str());
+	vscode::io::socket_c client(addr.c_str());
+	return transfer(server, client, total, msgsize);
+}
+
+#if !defined(_WIN32)
+static double throughput_shm(const std::string& name, size_t total, size_t msgsize)
+{
+	vscode::io::shm server;
+	vscode::io::shm client;
+	if (!server.open_server(name)) {
+		return -1;
+	}
+	client.open_client(name);
+	return transfer(server, client, total, msgsize);
+}
+#endif
+
+static bool bench_throughput(json_writer& res, size_t total, int repeat)
+{
+	static const size_t msgsizes[] = { 256, 4 * 1024, 64 * 1024 };
+	typedef std::function<double(size_t)> transport;
+	std::vector<std::pair<const char*, transport>> transports;
+	transports.emplace_back("tcp", [&](size_t msgsize) { return throughput_socket("127.0.0.1:43782", total, msgsize); });
+#if !defined(_WIN32)
+	std::string unique = "debugger-netbench-" + std::to_string(getpid());
+	transports.emplace_back("unix", [&](size_t msgsize) { return throughput_socket("unix:/tmp/" + unique + ".sock", total, msgsize); });
+	transports.emplace_back("shm", [&](size_t msgsize) { return throughput_shm(unique, total, msgsize); });
+#endif
+	bool ok = true;
+	res.Key("bytes");
+	res.Uint64(total);
+	res.Key("mbps");
+	res.StartArray();
+	for (size_t msgsize : msgsizes) {
+		res.StartObject();
+		res.Key("message");
+		res.Uint64(msgsize);
+		for (auto& t : transports) {
+			double best = -1;
+			for (int i = 0; i < repeat; ++i) {
+				best = std::max(best, t.second(msgsize));
+			}
+			res.Key(t.first);
+			res.Double(best);
+			ok = ok && best > 0;
+		}
+		res.EndObject();
+	}
+	res.EndArray();
+	return ok;
+}
+
+static std::string message_kind(const rapidjson::Value& d)
+{
+	std::string kind = d.HasMember("type") && d["type"].IsString() ? d["type"].GetString() : "?";
+	for (const char* key : { "command", "event" }) {
+		if (d.HasMember(key) && d[key].IsString()) {
+			return kind + " " + d[key].GetString();
+		}
+	}
+	return kind;
+}
+
+struct encoding_result
+{
+	size_t bytes = 0;
+	double encode_ms = 0;
+	double decode_ms = 0;
+};
+
+static void output_encoding(json_writer& res, const char* name, const encoding_result& r)
+{
+	res.Key(name);
+	res.StartObject();
+	res.Key("bytes");
+	res.Uint64(r.bytes);
+	res.Key("encodeMs");
+	res.Double(r.encode_ms);
+	res.Key("decodeMs");
+	res.Double(r.decode_ms);
+	res.EndObject();
+}
+
+// Best of `repeat` passes over every message, encoding with rapidjson's
+// Writer or cbor::writer, and decoding back into a Document.
+template <bool Cbor>
+static encoding_result measure_encoding(const std::vector<rapidjson::Document>& docs, std::vector<std::string>& encoded, int repeat)
+{
+	encoding_result r;
+	encoded.assign(docs.size(), std::string());
+	for (int i = 0; i < repeat; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t j = 0; j < docs.size(); ++j) {
+			if (Cbor) {
+				vscode::cbor::writer w;
+				docs[j].Accept(w);
+				encoded[j].assign(w.data(), w.size());
+			}
+			else {
+				rapidjson::StringBuffer buffer;
+				rapidjson::Writer<rapidjson::StringBuffer> w(buffer);
+				docs[j].Accept(w);
+				encoded[j].assign(buffer.GetString(), buffer.GetSize());
+			}
+		}
+		double encode = elapsed_ms(start);
+		start = std::chrono::steady_clock::now();
+		for (auto& e : encoded) {
+			rapidjson::Document d;
+			if (Cbor) {
+				vscode::cbor::parse(e.data(), e.size(), d);
+			}
+			else {
+				d.Parse(e.data(), e.size());
+			}
+		}
+		double decode = elapsed_ms(start);
+		if (i == 0 || encode < r.encode_ms) r.encode_ms = encode;
+		if (i == 0 || decode < r.decode_ms) r.decode_ms = decode;
+	}
+	for (auto& e : encoded) {
+		r.bytes += e.size();
+	}
+	return r;
+}
+
+static bool bench_cbor(json_writer& res, const char* session, int repeat)
+{
+	std::vector<vscode::io::record_entry> entries;
+	if (!session || !vscode::io::read_recording(session, entries)) {
+		fprintf(stderr, "cannot read recording: %s\n", session ? session : "(none)");
+		return false;
+	}
+	std::vector<rapidjson::Document> docs;
+	for (auto& e : entries) {
+		rapidjson::Document d;
+		if (vscode::cbor::is_cbor(e.data.data(), e.data.size())) {
+			if (!vscode::cbor::parse(e.data.data(), e.data.size(), d)) continue;
+		}
+		else if (d.Parse(e.data.data(), e.data.size()).HasParseError() || !d.IsObject()) {
+			continue;
+		}
+		docs.emplace_back(std::move(d));
+	}
+	std::vector<std::string> json, cbor;
+	encoding_result rj = measure_encoding<false>(docs, json, repeat);
+	encoding_result rc = measure_encoding<true>(docs, cbor, repeat);
+
+	std::map<std::string, std::pair<size_t, std::pair<size_t, size_t>>> kinds;
+	for (size_t i = 0; i < docs.size(); ++i) {
+		auto& k = kinds[message_kind(docs[i])];
+		k.first++;
+		k.second.first += json[i].size();
+		k.second.second += cbor[i].size();
+	}
+	std::vector<std::pair<std::string, std::pair<size_t, std::pair<size_t, size_t>>>> sorted(kinds.begin(), kinds.end());
+	std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.second.first > b.second.second.first; });
+
+	res.Key("messages");
+	res.Uint64(docs.size());
+	output_encoding(res, "json", rj);
+	output_encoding(res, "cbor", rc);
+	res.Key("kinds");
+	res.StartArray();
+	for (auto& k : sorted) {
+		res.StartObject();
+		res.Key("name");
+		res.String(k.first.c_str());
+		res.Key("count");
+		res.Uint64(k.second.first);
+		res.Key("jsonBytes");
+		res.Uint64(k.second.second.first);
+		res.Key("cborBytes");
+		res.Uint64(k.second.second.second);
+		res.EndObject();
+	}
+	res.EndArray();
+	return true;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: debugger-netbench epoll|latency|throughput|cbor [--repeat <n>] [--bytes <n>] [--count <n>] [--session <file>]\n");
+	exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) usage();
+	std::string mode = argv[1];
+	int repeat = 3;
+	size_t bytes = 64 * 1024 * 1024;
+	size_t count = 1000;
+	const char* session = nullptr;
+	for (int i = 2; i < argc; ++i) {
+		if (i + 1 >= argc) usage();
+		if (strcmp(argv[i], "--repeat") == 0) repeat = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--bytes") == 0) bytes = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--session") == 0) session = argv[++i];
+		else if (strcmp(argv[i], "--count") == 0) count = std::max<size_t>(1, (size_t)atoll(argv[++i]));
+		else usage();
+	}
+
+	net::socket::initialize();
+	bool ok = true;
+	rapidjson::StringBuffer sb;
+	json_writer res(sb);
+	res.StartObject();
+	res.Key("mode");
+	res.String(mode.c_str());
+#if !defined(_WIN32)
+	if (mode == "epoll") {
+		bench_epoll(res, bytes, repeat);
+	}
+	else
+#endif
+	if (mode == "latency") {
+		ok = bench_latency(res, count);
+	}
+	else if (mode == "throughput") {
+		ok = bench_throughput(res, bytes, repeat);
+	}
+	else if (mode == "cbor") {
+		ok = bench_cbor(res, session, repeat);
+	}
+	else {
+		usage();
+	}
+	res.EndObject();
+	puts(sb.GetString());
+	return ok ? 0 : 1;
+}
@@ -139,8 +139,12 @@ namespace vscode
 		}
 		lua_State* L = debug.L();
 		lua::Debug* ar = debug.value();
-		if (!cond.empty() && !evaluate_isok(L, ar, cond)) {
-			return false;
+		if (!cond.empty()) {
+			DEBUGGER_STATS_ADD(dbg.stats(), condition, 1);
+			DEBUGGER_STATS_TIMER(timer, dbg.stats().condition_time);
+			if (!evaluate_isok(L, ar, cond)) {
+				return false;
+			}
 		}
 		hit++;
 		if (!hitcond.empty() && !evaluate_isok(L, ar, std::to_string(hit) + " " + hitcond)) {
@@ -193,17 +197,22 @@ namespace vscode
 			defined[line] = eLine::defined;
 		}
 
+		bool changed = false;
 		for (size_t i = 0; i < waitverfy.size();) {
 			bp_breakpoint& bp = waitverfy[i];
 			if (bp.verify(*this, &dbg)) {
 				std::swap(waitverfy[i], waitverfy.back());
 				verified.insert(std::make_pair(waitverfy.back().line, waitverfy.back()));
 				waitverfy.pop_back();
+				changed = true;
 			}
 			else {
 				++i;
 			}
 		}
+		if (changed) {
+			dbg.bump_epoch();
+		}
 	}
 
 	bp_breakpoint& bp_source::add(size_t line, rapidjson::Value const& bpinfo, size_t& next_id)
@@ -273,6 +282,7 @@ namespace vscode
 		: dbg_(dbg)
 		, files_()
 		, next_id_(0)
+		, functionLimit_(0)
 	{ }
 
 	void breakpointMgr::clear()
@@ -309,36 +319,54 @@ namespace vscode
 		}
 	}
 
-	bp_source* breakpointMgr::get_function(debug& debug)
+	bp_source* breakpointMgr::get_function(debug& debug, intptr_t f)
 	{
 		if (debug.is_virtual()) {
 			source* s = dbg_.openVSource();
 			bp_source* func = &get_source(*s);
 			return func;
 		}
-		lua_State* L = debug.L();
-		lua::Debug* ar = debug.value();
-		if (!lua_getinfo(L, "f", (lua_Debug*)ar)) {
+		if (!f) {
 			return nullptr;
 		}
-		intptr_t f = (intptr_t)lua_getprotohash(L, -1);
-		lua_pop(L, 1);
+		lua_State* L = debug.L();
+		lua::Debug* ar = debug.value();
 		bp_source* func = nullptr;
 		if (functions_.get(f, func)) {
+			DEBUGGER_STATS_ADD(dbg_.stats(), get_function_hit, 1);
 			return func;
 		}
+		DEBUGGER_STATS_ADD(dbg_.stats(), get_function_miss, 1);
 		if (lua_getinfo(L, "SL", (lua_Debug*)ar)) {
-			source* s = dbg_.createSource(ar);
+			source* s = dbg_.createSource(ar, L);
 			if (s && s->valid) {
 				func = &get_source(*s);
 				func->update(L, ar);
 			}
 		}
 		lua_pop(L, 1);
+		// Only a cache of lookups: when full, start over rather than track
+		// recency on every call.
+		if (functionLimit_ && functions_.size() >= functionLimit_) {
+			functions_.clear();
+		}
 		functions_.put(f, func);
 		return func;
 	}
 
+	void breakpointMgr::set_limit(size_t functions)
+	{
+		functionLimit_ = functions;
+		if (functionLimit_ && functions_.size() > functionLimit_) {
+			functions_.clear();
+		}
+	}
+
+	memory_usage breakpointMgr::function_usage() const
+	{
+		return { functions_.size(), functions_.bytes(), functionLimit_ };
+	}
+
 	void breakpointMgr::set_breakpoint(source& s, rapidjson::Value const& args, wprotocol& res)
 	{
 		bp_source& src = get_source(s);
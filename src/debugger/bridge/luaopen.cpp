@@ -3,9 +3,20 @@
 #include <debugger/debugger.h>
 #include <debugger/io/socket.h>
 #include <debugger/io/namedpipe.h>
+#include <debugger/io/shm.h>
+#include <debugger/io/recorder.h>
+#include <debugger/config.h>
 #include <base/util/unicode.h>
+#include <atomic>
 #include <memory>  
+#include <mutex>
 #include <string_view>
+#include <thread>
+#include <vector>
+#include <string.h>
+#if !defined(_WIN32)
+#include <signal.h>
+#endif
 
 #if defined(DEBUGGER_BRIDGE)
 #include <intrin.h>
@@ -24,21 +35,75 @@ namespace luaw {
 		std::unique_ptr<vscode::io::socket_s> socket_s;
 		std::unique_ptr<vscode::io::socket_c> socket_c;
 		std::unique_ptr<vscode::io::namedpipe> namedpipe;
+		std::unique_ptr<vscode::io::shm> shm;
+		std::unique_ptr<vscode::io::recorder> recorder;
 		std::unique_ptr<vscode::debugger> dbg;
+		// `dbg` once it is ready to use, for the bindings, which may run on
+		// any thread while another one activates.
+		std::atomic<vscode::debugger*> active { nullptr };
+		std::string record;
 		bool guard = false;
+		// Kept while dormant and applied when activated, under `mtx`. A
+		// print redirect is applied on the thread of its own lua_State.
+		std::mutex mtx;
+		std::string address;
+		std::vector<std::pair<int, std::string>> configs;
+		std::vector<std::pair<lua_State*, std::string>> redirects;
+		bool waiting = false;
+
+		vscode::debugger* get_dbg()
+		{
+			return active.load(std::memory_order_acquire);
+		}
+
+		void publish()
+		{
+			active.store(dbg.get(), std::memory_order_release);
+		}
+
+		vscode::io::base* wrap(vscode::io::base* io)
+		{
+			if (record.empty()) {
+				return io;
+			}
+			recorder.reset(new vscode::io::recorder(io, record.c_str()));
+			return recorder.get();
+		}
 
 		void listen_tcp(const char* addr)
 		{
 			if (namedpipe || dbg) return;
 			socket_s.reset(new vscode::io::socket_s(addr));
-			dbg.reset(new vscode::debugger(socket_s.get()));
+			dbg.reset(new vscode::debugger(wrap(socket_s.get())));
 		}
 
 		void connect_tcp(const char* addr)
 		{
 			if (namedpipe || dbg) return;
 			socket_c.reset(new vscode::io::socket_c(addr));
-			dbg.reset(new vscode::debugger(socket_c.get()));
+			dbg.reset(new vscode::debugger(wrap(socket_c.get())));
+		}
+
+		// Fails if another live server holds the name. When `retry` is
+		// set the debugger is created anyway and keeps trying to take it.
+		bool listen_shm(const char* name, bool retry)
+		{
+			if (namedpipe || dbg) return true;
+			shm.reset(new vscode::io::shm());
+			if (!shm->open_server(name) && !retry) {
+				shm.reset();
+				return false;
+			}
+			dbg.reset(new vscode::debugger(wrap(shm.get())));
+			return true;
+		}
+
+		void connect_shm(const char* name)
+		{
+			if (namedpipe || dbg) return;
+			shm.reset(new vscode::io::shm());
+			shm->open_client(name);
+			dbg.reset(new vscode::debugger(wrap(shm.get())));
 		}
 
 #if defined(_WIN32)
@@ -47,9 +112,118 @@ namespace luaw {
 			if (namedpipe || dbg) return;
 			namedpipe.reset(new vscode::io::namedpipe());
 			namedpipe->open_server(name);
-			dbg.reset(new vscode::debugger(namedpipe.get()));
+			dbg.reset(new vscode::debugger(wrap(namedpipe.get())));
 		}
 #endif
+
+		// Returns false if the address can't be opened now; `retry` opens
+		// it anyway where the transport can wait for it, as an activation
+		// has no caller to report to.
+		bool open(const char* addr, bool retry = false)
+		{
+			if (strncmp(addr, "listen:shm:", 11) == 0) {
+				return listen_shm(addr + 11, retry);
+			}
+			else if (strncmp(addr, "connect:shm:", 12) == 0) {
+				connect_shm(addr + 12);
+			}
+			else if (strncmp(addr, "shm:", 4) == 0) {
+				return listen_shm(addr + 4, retry);
+			}
+			else if (strncmp(addr, "listen:", 7) == 0) {
+				listen_tcp(addr + 7);
+			}
+			else if (strncmp(addr, "connect:", 8) == 0) {
+				connect_tcp(addr + 8);
+			}
+#if defined(_WIN32)
+			else if (strncmp(addr, "pipe:", 5) == 0) {
+				listen_pipe(base::u2w(addr + 5).c_str());
+			}
+#endif
+			else {
+				listen_tcp(addr);
+			}
+			return true;
+		}
+
+		void open_redirect(lua_State* L, const char* type)
+		{
+			if (strcmp(type, "stdout") == 0) {
+				dbg->open_redirect(vscode::eRedirect::stdoutput);
+			}
+			else if (strcmp(type, "stderr") == 0) {
+				dbg->open_redirect(vscode::eRedirect::stderror);
+			}
+			else if (strcmp(type, "print") == 0) {
+				dbg->open_redirect(vscode::eRedirect::print, L);
+			}
+		}
+
+		// Opens the io a dormant `dbg:io` asked for and replays what was
+		// configured meanwhile. Runs on the thread of `L`, and returns the
+		// debugger once activated.
+		vscode::debugger* activate(lua_State* L)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (!dbg && !address.empty()) {
+				open(address.c_str(), true);
+				if (dbg) {
+					for (auto& cfg : configs) {
+						std::string err;
+						dbg->set_config(cfg.first, cfg.second, err);
+					}
+					configs.clear();
+					if (waiting) {
+						dbg->wait_client();
+					}
+					publish();
+				}
+			}
+			if (dbg) {
+				apply_redirects(L);
+			}
+			return dbg.get();
+		}
+
+		// Applies the redirects queued by `L`'s state, and those that are
+		// not tied to a state. Called with `mtx` held.
+		void apply_redirects(lua_State* L)
+		{
+			lua_State* ml = L ? get_mainthread(L) : nullptr;
+			auto it = redirects.begin();
+			while (it != redirects.end()) {
+				if (it->first && it->first != ml) {
+					++it;
+					continue;
+				}
+				open_redirect(L, it->second.c_str());
+				it = redirects.erase(it);
+			}
+		}
+
+		// Forgets what `ml`'s state queued, as it is going away.
+		void forget(lua_State* ml)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			auto it = redirects.begin();
+			while (it != redirects.end()) {
+				if (it->first == ml) {
+					it = redirects.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+		}
+
+		static lua_State* get_mainthread(lua_State* L)
+		{
+			lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+			lua_State* ml = lua_tothread(L, -1);
+			lua_pop(L, 1);
+			return ml;
+		}
 	};
 
 	static std::unique_ptr<ud> global;
@@ -62,6 +236,111 @@ namespace luaw {
 		return *global;
 	}
 
+	// Dormant mode: `dbg:io` and `dbg:start` only record the address and the
+	// states, so until activated there is no debugger thread, no socket and
+	// no hook. debugger_activate may run in a signal handler, hence a fixed
+	// table of atomics, and all it does is set a one-shot hook on each
+	// recorded state; the hook then activates on the state's own thread.
+	// lua_States waiting for debugger_activate, which may run in a signal
+	// handler. Slots sit in chunks that are only ever appended and never
+	// freed, so it walks them without locking or allocating, and a slot is
+	// reused once its state is removed.
+	namespace dormant {
+		static const size_t chunk_size = 256;
+
+		// `busy` counts activations reading the slot, so that remove can
+		// wait them out before the state is closed.
+		struct slot {
+			std::atomic<lua_State*> L { nullptr };
+			std::atomic<int>        busy { 0 };
+		};
+
+		struct chunk {
+			slot                slots[chunk_size];
+			std::atomic<chunk*> next { nullptr };
+		};
+
+		static chunk states;
+		static std::atomic<bool> enabled(false);
+		static std::atomic<bool> activated(false);
+
+		static void add(lua_State* L)
+		{
+			for (chunk* c = &states;; c = c->next.load()) {
+				for (auto& s : c->slots) {
+					lua_State* expected = nullptr;
+					if (s.L.compare_exchange_strong(expected, L)) {
+						return;
+					}
+				}
+				if (!c->next.load()) {
+					chunk* n = new chunk;
+					chunk* expected = nullptr;
+					if (!c->next.compare_exchange_strong(expected, n)) {
+						delete n;
+					}
+				}
+			}
+		}
+
+		static bool remove(lua_State* L)
+		{
+			for (chunk* c = &states; c; c = c->next.load()) {
+				for (auto& s : c->slots) {
+					lua_State* expected = L;
+					if (s.L.compare_exchange_strong(expected, nullptr)) {
+						while (s.busy.load()) {
+							std::this_thread::yield();
+						}
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		static void activate(lua_Hook hook)
+		{
+			for (chunk* c = &states; c; c = c->next.load()) {
+				for (auto& s : c->slots) {
+					s.busy.fetch_add(1);
+					lua_State* L = s.L.load();
+					if (L) {
+						lua_sethook(L, hook, LUA_MASKCALL | LUA_MASKRET | LUA_MASKCOUNT, 1);
+					}
+					s.busy.fetch_sub(1);
+				}
+			}
+		}
+	}
+
+	static void activate_hook(lua_State* L, lua_Debug* ar)
+	{
+		lua_sethook(L, 0, 0, 0);
+		ud& self = get();
+		vscode::debugger* dbg;
+		if (dormant::remove(L)) {
+			dbg = self.activate(L);
+		}
+		else {
+			dbg = self.get_dbg();
+			if (dbg) {
+				// Started on its own just before the knock replaced its hook.
+				dbg->detach_lua(L, true);
+			}
+		}
+		if (dbg) {
+			dbg->attach_lua(L);
+		}
+	}
+
+#if !defined(_WIN32)
+	static void activate_signal(int)
+	{
+		debugger_activate();
+	}
+#endif
+
 	static int constructor(lua_State* L)
 	{
 		lua_newuserdata(L, 1);
@@ -69,24 +348,66 @@ namespace luaw {
 		return 1;
 	}
 
-	static int io(lua_State* L)
+	static bool valid_address(const char* addr)
 	{
-		ud& self = get();
-		const char* addr = luaL_checkstring(L, 2);
 		if (strncmp(addr, "listen:", 7) == 0) {
-			self.listen_tcp(addr + 7);
+			addr += 7;
 		}
 		else if (strncmp(addr, "connect:", 8) == 0) {
-			self.connect_tcp(addr + 8);
+			addr += 8;
 		}
-#if defined(_WIN32)
-		else if (strncmp(addr, "pipe:", 5) == 0) {
-			self.listen_pipe(base::u2w(addr + 5).c_str());
+		if (strncmp(addr, "shm:", 4) == 0) {
+			return addr[4] != '\0';
+		}
+		return vscode::io::sock_stream::valid_address(addr);
+	}
+
+	static int io(lua_State* L)
+	{
+		ud& self = get();
+		const char* addr = luaL_checkstring(L, 2);
+		if (!valid_address(addr)) {
+			return luaL_error(L, "Invalid address: %s.", addr);
+		}
+		if (dormant::enabled && !dormant::activated) {
+			std::lock_guard<std::mutex> lock(self.mtx);
+			self.address = addr;
 		}
-#endif
 		else {
-			self.listen_tcp(addr);
+			if (!self.open(addr)) {
+				return luaL_error(L, "Cannot listen on %s: the name is in use.", addr);
+			}
+			self.publish();
+		}
+		lua_pushvalue(L, 1);
+		return 1;
+	}
+
+	static int dormant_(lua_State* L)
+	{
+		ud& self = get();
+		if (!self.get_dbg()) {
+			dormant::enabled = true;
+		}
+#if !defined(_WIN32)
+		int sig = (int)luaL_optinteger(L, 2, SIGUSR2);
+		if (sig > 0) {
+			struct sigaction sa;
+			memset(&sa, 0, sizeof(sa));
+			sa.sa_handler = activate_signal;
+			sigemptyset(&sa.sa_mask);
+			sa.sa_flags = SA_RESTART;
+			sigaction(sig, &sa, NULL);
 		}
+#endif
+		lua_pushvalue(L, 1);
+		return 1;
+	}
+
+	static int record(lua_State* L)
+	{
+		ud& self = get();
+		self.record = luaL_checkstring(L, 2);
 		lua_pushvalue(L, 1);
 		return 1;
 	}
@@ -94,11 +415,16 @@ namespace luaw {
 	static int wait(lua_State* L)
 	{
 		ud& self = get();
-		if (!self.dbg) {
+		vscode::debugger* dbg = self.get_dbg();
+		if (dormant::enabled && !dbg) {
+			std::lock_guard<std::mutex> lock(self.mtx);
+			self.waiting = true;
+		}
+		if (!dbg) {
 			lua_pushvalue(L, 1);
 			return 1;
 		}
-		self.dbg->wait_client();
+		dbg->wait_client();
 		lua_pushvalue(L, 1);
 		return 1;
 	}
@@ -106,39 +432,65 @@ namespace luaw {
 	static int start(lua_State* L)
 	{
 		ud& self = get();
-		if (!self.dbg) {
+		vscode::debugger* dbg = self.get_dbg();
+		if (dormant::enabled) {
+			if (!dbg && !dormant::activated) {
+				lua_State* ml = ud::get_mainthread(L);
+				dormant::add(ml);
+				if (!dormant::activated || !dormant::remove(ml)) {
+					lua_pushvalue(L, 1);
+					return 1;
+				}
+			}
+			dbg = self.activate(L);
+		}
+		if (!dbg) {
 			lua_pushvalue(L, 1);
 			return 1;
 		}
-		self.dbg->attach_lua(L);
+		dbg->attach_lua(L);
 		lua_pushvalue(L, 1);
 		return 1;
 	}
 
-	static int config(lua_State* L)
+	static int set_config(lua_State* L, ud& self, vscode::debugger* dbg, int level, int idx)
 	{
-		ud& self = get();
-		if (!self.dbg) {
-			lua_pushvalue(L, 1);
-			return 1;
+		if (lua_type(L, idx) != LUA_TSTRING) {
+			return 0;
 		}
-		if (lua_type(L, 2) == LUA_TSTRING) {
-			size_t len = 0;
-			const char* str = luaL_checklstring(L, 2, &len);
-			std::string err = "unknown";
-			if (!self.dbg->set_config(0, std::string(str, len), err)) {
+		std::string cfg(luaL_checkstrview(L, idx));
+		std::string err = "unknown";
+		if (dbg) {
+			if (!dbg->set_config(level, cfg, err)) {
 				lua_pushlstring(L, err.data(), err.size());
 				return lua_error(L);
 			}
+			return 0;
 		}
-		if (lua_type(L, 3) == LUA_TSTRING) {
-			size_t len = 0;
-			const char* str = luaL_checklstring(L, 3, &len);
-			std::string err = "unknown";
-			if (!self.dbg->set_config(2, std::string(str, len), err)) {
-				lua_pushlstring(L, err.data(), err.size());
-				return lua_error(L);
-			}
+		// Checked now, so that a dormant debuggee sees the same errors.
+		vscode::config check;
+		if (!check.init(level, cfg, err)) {
+			lua_pushlstring(L, err.data(), err.size());
+			return lua_error(L);
+		}
+		std::lock_guard<std::mutex> lock(self.mtx);
+		if (self.dbg) {
+			// Activated meanwhile.
+			self.dbg->set_config(level, cfg, err);
+		}
+		else {
+			self.configs.push_back(std::make_pair(level, cfg));
+		}
+		return 0;
+	}
+
+	static int config(lua_State* L)
+	{
+		ud& self = get();
+		vscode::debugger* dbg = self.get_dbg();
+		if (dbg || dormant::enabled) {
+			set_config(L, self, dbg, 0, 2);
+			set_config(L, self, dbg, 2, 3);
 		}
 		lua_pushvalue(L, 1);
 		return 1;
@@ -147,20 +499,21 @@ namespace luaw {
 	static int redirect(lua_State* L)
 	{
 		ud& self = get();
-		if (!self.dbg) {
+		if (lua_type(L, 2) != LUA_TSTRING) {
 			lua_pushvalue(L, 1);
 			return 1;
 		}
-		if (lua_type(L, 2) == LUA_TSTRING) {
-			const char* type = luaL_checkstring(L, 2);
-			if (strcmp(type, "stdout") == 0) {
-				self.dbg->open_redirect(vscode::eRedirect::stdoutput);
-			}
-			else if (strcmp(type, "stderr") == 0) {
-				self.dbg->open_redirect(vscode::eRedirect::stderror);
-			}
-			else if (strcmp(type, "print") == 0) {
-				self.dbg->open_redirect(vscode::eRedirect::print, L);
+		const char* type = luaL_checkstring(L, 2);
+		if (self.get_dbg()) {
+			self.open_redirect(L, type);
+		}
+		else if (dormant::enabled) {
+			std::lock_guard<std::mutex> lock(self.mtx);
+			lua_State* ml = strcmp(type, "print") == 0 ? ud::get_mainthread(L) : nullptr;
+			self.redirects.push_back(std::make_pair(ml, std::string(type)));
+			if (self.dbg) {
+				// Activated meanwhile.
+				self.apply_redirects(L);
 			}
 		}
 		lua_pushvalue(L, 1);
@@ -190,29 +543,97 @@ namespace luaw {
 			return luaL_error(L, "Unknown exception type: %s.", type_str.data());
 		}
 		luaL_checktype(L, 3, LUA_TSTRING);
+		int level = (int)luaL_checkinteger(L, 4);
+		vscode::debugger* dbg = self.get_dbg();
+		if (!dbg) {
+			return 0;
+		}
 		lua_pushvalue(L, 3);
-		self.dbg->exception(L, type, (int)luaL_checkinteger(L, 4));
+		dbg->exception(L, type, level);
 		return 0;
 	}
 
 	static int event(lua_State* L)
 	{
 		ud& self = get();
-		self.dbg->event(luaL_checkstring(L, 2), L, 3, lua_gettop(L));
+		const char* name = luaL_checkstring(L, 2);
+		vscode::debugger* dbg = self.get_dbg();
+		if (!dbg) {
+			return 0;
+		}
+		dbg->event(name, L, 3, lua_gettop(L));
+		return 0;
+	}
+
+	static int vsource(lua_State* L)
+	{
+		ud& self = get();
+		size_t len = 0;
+		const char* code = luaL_checklstring(L, 2, &len);
+		const char* name = luaL_optstring(L, 3, nullptr);
+		vscode::debugger* dbg = self.get_dbg();
+		lua_pushinteger(L, dbg ? dbg->vsource(code, len, name) : 0);
+		return 1;
+	}
+
+	static int vcall(lua_State* L)
+	{
+		ud& self = get();
+		int handle = (int)luaL_checkinteger(L, 2);
+		vscode::debugger* dbg = self.get_dbg();
+		// 0 is what vsource returns without a debugger.
+		if (!dbg || handle == 0) {
+			return 0;
+		}
+		if (!dbg->vcall(L, handle)) {
+			return luaL_argerror(L, 2, "invalid source handle");
+		}
+		return 0;
+	}
+
+	static int vreturn(lua_State* L)
+	{
+		ud& self = get();
+		vscode::debugger* dbg = self.get_dbg();
+		if (!dbg) {
+			return 0;
+		}
+		dbg->vreturn(L);
+		return 0;
+	}
+
+	static int vline(lua_State* L)
+	{
+		ud& self = get();
+		int line = (int)luaL_checkinteger(L, 2);
+		if (!lua_isnoneornil(L, 3)) {
+			luaL_checktype(L, 3, LUA_TTABLE);
+		}
+		vscode::debugger* dbg = self.get_dbg();
+		if (!dbg) {
+			return 0;
+		}
+		dbg->vline(L, line, lua_isnoneornil(L, 3) ? -1 : 3);
 		return 0;
 	}
 
 	static int mt_gc(lua_State* L)
 	{
 		ud& self = get();
-		if (self.dbg) {
-			self.dbg->detach_lua(L);
+		dormant::remove(L);
+		self.forget(ud::get_mainthread(L));
+		vscode::debugger* dbg = self.get_dbg();
+		if (dbg) {
+			dbg->detach_lua(L);
 		}
 		if (self.guard) {
+			self.active.store(nullptr, std::memory_order_release);
 			self.dbg.reset();
+			self.recorder.reset();
 			self.socket_s.reset();
 			self.socket_c.reset();
 			self.namedpipe.reset();
+			self.shm.reset();
 		}
 		return 0;
 	}
@@ -221,12 +642,18 @@ namespace luaw {
 	{
 		luaL_Reg mt[] = {
 			{ "io", io },
+			{ "record", record },
+			{ "dormant", dormant_ },
 			{ "wait", wait },
 			{ "start", start },
 			{ "config", config },
 			{ "redirect", redirect },
 			{ "guard", guard },
 			{ "event", event },
+			{ "vsource", vsource },
+			{ "vcall", vcall },
+			{ "vreturn", vreturn },
+			{ "vline", vline },
 			{ "exception", exception },
 			{ "__gc", mt_gc },
 			{ NULL, NULL },
@@ -243,11 +670,13 @@ namespace luaw {
 #if defined(_WIN32)
 void debugger_create(const wchar_t* name)
 {
-	luaw::get().listen_pipe(name);
+	luaw::ud& self = luaw::get();
+	self.listen_pipe(name);
+	self.publish();
 }
 vscode::debugger* debugger_get()
 {
-	return luaw::get().dbg.get();
+	return luaw::get().get_dbg();
 }
 #endif
 
@@ -265,6 +694,12 @@ static void caller_is_luadll(void* callerAddress)
 }
 #endif
 
+void debugger_activate()
+{
+	luaw::dormant::activated = true;
+	luaw::dormant::activate(luaw::activate_hook);
+}
+
 int luaopen_debugger(lua_State* L)
 {
 #if defined(DEBUGGER_BRIDGE)
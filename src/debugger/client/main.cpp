@@ -194,6 +194,12 @@ static int run_tcp_attach(stdinput& io, vscode::rprotocol& init, vscode::rprotoc
 	std::string ip = args.HasMember("ip") ? args["ip"].Get<std::string>() : "127.0.0.1";
 	uint16_t port = args.HasMember("port") ? args["port"].GetUint() : 4278;
 	attach.connect(net::endpoint(ip, port));
+	// The link to a remote debuggee is the slow one, so it carries CBOR;
+	// tcp_attach turns every message back into JSON for the client.
+	auto& initargs = init["arguments"];
+	if (initargs.IsObject() && !initargs.HasMember("encoding")) {
+		initargs.AddMember("encoding", "cbor", init.GetAllocator());
+	}
 	attach.send(init);
 	attach.send(req);
 	for (;; sleep()) {
@@ -51,6 +51,9 @@ bool run_pipe_attach(stdinput& io, vscode::rprotocol& init, vscode::rprotocol& r
 			}
 		}
 		while (pipe.input(buf)) {
+			if (!vscode::cbor::to_json(buf)) {
+				continue;
+			}
 			io.output(buf.data(), buf.size());
 			if (m) {
 				m->unlock();
@@ -2,6 +2,36 @@
 #include <debugger/client/stdinput.h>
 #include <base/util/format.h>
 
+void tcp_decoder::push(const char* buf, size_t len)
+{
+	pending_.append(buf, len);
+}
+
+size_t tcp_decoder::raw_peek()
+{
+	return pending_.size();
+}
+
+bool tcp_decoder::raw_recv(char* buf, size_t len)
+{
+	if (len > pending_.size())
+		return false;
+	memcpy(buf, pending_.data(), len);
+	pending_.erase(0, len);
+	return true;
+}
+
+bool tcp_decoder::raw_send(const char* buf, size_t len)
+{
+	return false;
+}
+
+void tcp_decoder::close()
+{
+	pending_.clear();
+	clear();
+}
+
 tcp_attach::tcp_attach(stdinput& io_)
 	: poller()
 	, io(io_)
@@ -18,13 +48,23 @@ bool tcp_attach::event_in()
 	size_t len = base_type::recv(tmp.data(), tmp.size());
 	if (len == 0)
 		return true;
-	io.raw_output(tmp.data(), len);
+	decoder.push(tmp.data(), len);
+	decoder.update(0);
+	std::string msg;
+	while (decoder.input(msg)) {
+		if (!vscode::cbor::to_json(msg)) {
+			continue;
+		}
+		auto l = base::format("Content-Length: %d\r\n\r\n", msg.size());
+		io.raw_output(l.data(), l.size());
+		io.raw_output(msg.data(), msg.size());
+	}
 	return true;
 }
 
 void tcp_attach::send(const std::string& rp)
 {
-	base_type::send(base::format("Content-Length: %d\r\n\r\n", rp.size()));
+	base_type::send(base::format("Content-Length: %d\r\nAccept-Encoding: lz4\r\n\r\n", rp.size()));
 	base_type::send(rp.data(), rp.size());
 }
 
@@ -33,7 +73,7 @@ void tcp_attach::send(const vscode::rprotocol& rp)
 	rapidjson::StringBuffer buffer;
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 	rp.Accept(writer);
-	base_type::send(base::format("Content-Length: %d\r\n\r\n", buffer.GetSize()));
+	base_type::send(base::format("Content-Length: %d\r\nAccept-Encoding: lz4\r\n\r\n", buffer.GetSize()));
 	base_type::send(buffer.GetString(), buffer.GetSize());
 }
 
@@ -0,0 +1,299 @@
+#include <debugger/crc32.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#	define CRC_X86 1
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#		define CRC_TARGET(x)
+#	else
+#		include <cpuid.h>
+#		define CRC_TARGET(x) __attribute__((target(x)))
+#	endif
+#	include <nmmintrin.h>
+#	include <wmmintrin.h>
+#	include <smmintrin.h>
+#	if defined(_M_X64) || defined(__x86_64__)
+#		define CRC_X64 1
+#	endif
+#endif
+
+// All kernels work on the raw register: the public functions invert on the
+// way in and out, so kernels can hand a partial result to each other.
+
+namespace vscode { namespace crc {
+	typedef uint32_t (*update_t)(uint32_t crc, const unsigned char* buf, size_t len);
+
+	struct tables {
+		uint32_t t[8][256];
+
+		explicit tables(uint32_t poly)
+		{
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) ? (c >> 1) ^ poly : (c >> 1);
+				}
+				t[0][i] = c;
+			}
+			for (uint32_t i = 0; i < 256; ++i) {
+				for (int k = 1; k < 8; ++k) {
+					t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+				}
+			}
+		}
+	};
+
+	static const tables& ieee()
+	{
+		static const tables t(0xEDB88320);
+		return t;
+	}
+
+	static const tables& castagnoli()
+	{
+		static const tables t(0x82F63B78);
+		return t;
+	}
+
+	static uint32_t bytewise(const tables& tab, uint32_t c, const unsigned char* p, size_t n)
+	{
+		while (n--) {
+			c = tab.t[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+		}
+		return c;
+	}
+
+	static uint32_t load32(const unsigned char* p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	// Slicing-by-8: eight table lookups per 8 input bytes.
+	static uint32_t slice8(const tables& tab, uint32_t c, const unsigned char* p, size_t n)
+	{
+		const uint32_t (*t)[256] = tab.t;
+		for (; n >= 8; p += 8, n -= 8) {
+			uint32_t a = load32(p) ^ c;
+			uint32_t b = load32(p + 4);
+			c = t[7][a & 0xFF] ^ t[6][(a >> 8) & 0xFF] ^ t[5][(a >> 16) & 0xFF] ^ t[4][a >> 24]
+			  ^ t[3][b & 0xFF] ^ t[2][(b >> 8) & 0xFF] ^ t[1][(b >> 16) & 0xFF] ^ t[0][b >> 24];
+		}
+		return bytewise(tab, c, p, n);
+	}
+
+	static uint32_t crc32_table(uint32_t c, const unsigned char* p, size_t n)  { return bytewise(ieee(), c, p, n); }
+	static uint32_t crc32_slice8(uint32_t c, const unsigned char* p, size_t n) { return slice8(ieee(), c, p, n); }
+	static uint32_t crc32c_table(uint32_t c, const unsigned char* p, size_t n)  { return bytewise(castagnoli(), c, p, n); }
+	static uint32_t crc32c_slice8(uint32_t c, const unsigned char* p, size_t n) { return slice8(castagnoli(), c, p, n); }
+
+#if defined(CRC_X86)
+	// The SSE4.2 crc32 instruction implements CRC-32C only.
+	CRC_TARGET("sse4.2")
+	static uint32_t crc32c_sse42(uint32_t c, const unsigned char* p, size_t n)
+	{
+		for (; n && ((uintptr_t)p & 7); --n) {
+			c = _mm_crc32_u8(c, *p++);
+		}
+#if defined(CRC_X64)
+		uint64_t c64 = c;
+		for (; n >= 8; p += 8, n -= 8) {
+			c64 = _mm_crc32_u64(c64, *(const uint64_t*)p);
+		}
+		c = (uint32_t)c64;
+#endif
+		for (; n >= 4; p += 4, n -= 4) {
+			c = _mm_crc32_u32(c, *(const uint32_t*)p);
+		}
+		for (; n; --n) {
+			c = _mm_crc32_u8(c, *p++);
+		}
+		return c;
+	}
+
+	// CRC-32 by carry-less multiplication, after Gopal et al., "Fast CRC
+	// Computation for Generic Polynomials Using PCLMULQDQ Instruction":
+	// four 128-bit lanes are folded 64 bytes at a time, folded into one,
+	// and Barrett-reduced. Needs at least 64 bytes; the tail that is not a
+	// multiple of 16 goes through slicing-by-8.
+	CRC_TARGET("sse4.1,pclmul")
+	static uint32_t crc32_pclmul(uint32_t c, const unsigned char* p, size_t n)
+	{
+		if (n < 64) {
+			return crc32_slice8(c, p, n);
+		}
+		alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+		alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+		alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+		alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+		__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+		x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+		x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+		x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+		x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+		x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)c));
+		x0 = _mm_load_si128((const __m128i*)k1k2);
+		p += 64;
+		n -= 64;
+
+		for (; n >= 64; p += 64, n -= 64) {
+			x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+			x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+			x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+			x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+			x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+			x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+			x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+			x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+			x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(p + 0x00)));
+			x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(p + 0x10)));
+			x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(p + 0x20)));
+			x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(p + 0x30)));
+		}
+
+		// Fold the four lanes into one.
+		x0 = _mm_load_si128((const __m128i*)k3k4);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+		for (; n >= 16; p += 16, n -= 16) {
+			x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+			x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+			x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)p)), x5);
+		}
+
+		// 128 -> 64 bits.
+		x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+		x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+		x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+		x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+		x2 = _mm_srli_si128(x1, 4);
+		x1 = _mm_and_si128(x1, x3);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_xor_si128(x1, x2);
+
+		// Barrett reduction to 32 bits.
+		x0 = _mm_load_si128((const __m128i*)poly);
+		x2 = _mm_and_si128(x1, x3);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+		x2 = _mm_and_si128(x2, x3);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x1 = _mm_xor_si128(x1, x2);
+		c = (uint32_t)_mm_extract_epi32(x1, 1);
+
+		return crc32_slice8(c, p, n);
+	}
+
+	struct cpu {
+		bool sse42 = false;
+		bool pclmul = false;
+
+		cpu()
+		{
+			unsigned int ecx;
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 1);
+			ecx = (unsigned int)info[2];
+#else
+			unsigned int eax, ebx, edx;
+			if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+				return;
+			}
+#endif
+			sse42 = (ecx & (1u << 20)) != 0;
+			// The fold uses pextrd from SSE4.1, implied by SSE4.2.
+			pclmul = sse42 && (ecx & (1u << 1)) != 0;
+		}
+	};
+
+	static const cpu& features()
+	{
+		static const cpu c;
+		return c;
+	}
+#endif
+
+	static update_t crc32_update(kernel k)
+	{
+		switch (k) {
+		case kernel::table:  return crc32_table;
+		case kernel::slice8: return crc32_slice8;
+#if defined(CRC_X86)
+		case kernel::pclmul: return features().pclmul ? crc32_pclmul : nullptr;
+#endif
+		default:             return nullptr;
+		}
+	}
+
+	static update_t crc32c_update(kernel k)
+	{
+		switch (k) {
+		case kernel::table:  return crc32c_table;
+		case kernel::slice8: return crc32c_slice8;
+#if defined(CRC_X86)
+		case kernel::sse42:  return features().sse42 ? crc32c_sse42 : nullptr;
+#endif
+		default:             return nullptr;
+		}
+	}
+
+	const char* name(kernel k)
+	{
+		switch (k) {
+		case kernel::table:  return "table";
+		case kernel::slice8: return "slice8";
+		case kernel::sse42:  return "sse42";
+		case kernel::pclmul: return "pclmul";
+		}
+		return "?";
+	}
+
+	bool supported(kernel k, bool c)
+	{
+		return (c ? crc32c_update(k) : crc32_update(k)) != nullptr;
+	}
+
+	kernel selected(bool c)
+	{
+		static const kernel best[] = { kernel::pclmul, kernel::sse42, kernel::slice8 };
+		for (kernel k : best) {
+			if (supported(k, c)) {
+				return k;
+			}
+		}
+		return kernel::table;
+	}
+
+	uint32_t crc32(kernel k, const unsigned char* buf, size_t len)
+	{
+		update_t f = crc32_update(k);
+		return f ? ~f(0xFFFFFFFF, buf, len) : 0;
+	}
+
+	uint32_t crc32c(kernel k, const unsigned char* buf, size_t len)
+	{
+		update_t f = crc32c_update(k);
+		return f ? ~f(0xFFFFFFFF, buf, len) : 0;
+	}
+}
+
+	uint32_t crc32(const unsigned char* buf, size_t len)
+	{
+		static const crc::update_t f = crc::crc32_update(crc::selected(false));
+		return ~f(0xFFFFFFFF, buf, len);
+	}
+
+	uint32_t crc32c(const unsigned char* buf, size_t len)
+	{
+		static const crc::update_t f = crc::crc32c_update(crc::selected(true));
+		return ~f(0xFFFFFFFF, buf, len);
+	}
+}
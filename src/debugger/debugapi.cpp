@@ -13,39 +13,77 @@ namespace vscode {
 		return s;
 	}
 
+	// Handles start from 1, so 0 can mean failure. Registering the same
+	// text again gives back the same handle.
+	int vdebugMgr::add_source(source* source) {
+		auto it = index_.find(source);
+		if (it != index_.end()) {
+			return it->second;
+		}
+		handles_.push_back(source);
+		int handle = (int)handles_.size();
+		index_.insert(std::make_pair(source, handle));
+		return handle;
+	}
+
+	source* vdebugMgr::find_source(int handle) {
+		if (handle <= 0 || (size_t)handle > handles_.size()) {
+			return nullptr;
+		}
+		return handles_[handle - 1];
+	}
+
+	lua::Debug* vdebugMgr::alloc() {
+		if (used_ < depth) {
+			return &records_[used_++];
+		}
+		return new lua::Debug;
+	}
+
+	void vdebugMgr::free(lua::Debug* vr) {
+		if (vr >= records_ && vr < records_ + depth) {
+			used_--;
+			return;
+		}
+		delete vr;
+	}
+
 	debug::debug(lua_State* l, lua::Debug* a)
 		: lua(l), ar(a), vr(0)
 	{ }
 
-	debug::debug(lua_State* l)
-		: lua(l), ar(0), vr(new lua::Debug)
+	debug::debug(lua_State* l, vdebugMgr& m)
+		: lua(l), ar(0), vr(m.alloc()), mgr(&m)
 	{ }
 
 	debug::debug(debug& o)
-		: lua(o.lua), ar(o.ar), vr(o.vr), scope(o.scope)
+		: lua(o.lua), ar(o.ar), vr(o.vr), mgr(o.mgr), scope(o.scope)
 	{
 		o.lua = 0;
 		o.ar = 0;
 		o.vr = 0;
+		o.mgr = 0;
 		o.scope = -1;
 	}
 
 	debug::~debug() {
-		delete vr;
+		if (vr) {
+			mgr->free(vr);
+		}
 	}
 
-	debug debug::event_call(lua_State* l) {
-		debug d(l);
+	debug debug::event_call(lua_State* l, vdebugMgr& m) {
+		debug d(l, m);
 		d.vr->event = LUA_HOOKCALL;
 		return d;
 	}
-	debug debug::event_return(lua_State* l) {
-		debug d(l);
+	debug debug::event_return(lua_State* l, vdebugMgr& m) {
+		debug d(l, m);
 		d.vr->event = LUA_HOOKRET;
 		return d;
 	}
-	debug debug::event_line(lua_State* l, int currentline, int scope) {
-		debug d(l);
+	debug debug::event_line(lua_State* l, vdebugMgr& m, int currentline, int scope) {
+		debug d(l, m);
 		d.vr->event = LUA_HOOKLINE;
 		d.vr->currentline = currentline;
 		d.scope = scope;
@@ -84,6 +84,26 @@ namespace vscode
 	{
 		impl_->event(name, L, argf, argl);
 	}
+
+	int debugger::vsource(const char* code, size_t len, const char* name)
+	{
+		return impl_->vsource(code, len, name);
+	}
+
+	bool debugger::vcall(lua_State* L, int handle)
+	{
+		return impl_->vcall(L, handle);
+	}
+
+	void debugger::vreturn(lua_State* L)
+	{
+		impl_->vreturn(L);
+	}
+
+	void debugger::vline(lua_State* L, int line, int scope)
+	{
+		impl_->vline(L, line, scope);
+	}
 }
 
 void debugger_set_luadll(void* luadll, void* getluaapi)
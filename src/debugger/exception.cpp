@@ -0,0 +1,203 @@
+#include <debugger/exception.h>
+#include <debugger/lua.h>
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+namespace vscode
+{
+	static const char* filter_name[] = { "lua_panic", "lua_pcall", "pcall", "xpcall" };
+
+	void exceptionMgr::clear()
+	{
+		filters_.clear();
+		reset_sites();
+	}
+
+	void exceptionMgr::set_breakpoints(rapidjson::Value const& args)
+	{
+		filters_.clear();
+		auto enable = [&](const std::string& filter, const std::string& cond) {
+			for (size_t i = 0; i < sizeof(filter_name) / sizeof(filter_name[0]); ++i) {
+				if (filter == "all" || filter == filter_name[i]) {
+					filters_[(eException)i] = cond;
+				}
+			}
+		};
+		if (args.HasMember("filters") && args["filters"].IsArray()) {
+			for (auto& v : args["filters"].GetArray()) {
+				if (v.IsString()) {
+					enable(v.Get<std::string>(), std::string());
+				}
+			}
+		}
+		if (args.HasMember("filterOptions") && args["filterOptions"].IsArray()) {
+			for (auto& v : args["filterOptions"].GetArray()) {
+				if (!v.IsObject() || !v.HasMember("filterId") || !v["filterId"].IsString()) {
+					continue;
+				}
+				std::string cond;
+				if (v.HasMember("condition") && v["condition"].IsString()) {
+					cond = v["condition"].Get<std::string>();
+				}
+				enable(v["filterId"].Get<std::string>(), cond);
+			}
+		}
+	}
+
+	// `pattern` is looked for anywhere in the message, '*' and '?' being
+	// wildcards; a leading '!' inverts the result.
+	bool exceptionMgr::match(const std::string& pattern, const char* str, size_t len)
+	{
+		const char* p = pattern.data();
+		size_t pn = pattern.size();
+		bool negate = pn > 0 && p[0] == '!';
+		if (negate) {
+			++p, --pn;
+		}
+		size_t pi = 0, si = 0, star = 0, mark = 0;
+		for (;;) {
+			if (pi == pn) {
+				return !negate;
+			}
+			if (si == len) {
+				break;
+			}
+			if (p[pi] == '*') {
+				star = ++pi;
+				mark = si;
+			}
+			else if (p[pi] == '?' || p[pi] == str[si]) {
+				++pi, ++si;
+			}
+			else {
+				pi = star;
+				si = ++mark;
+			}
+		}
+		while (pi < pn && p[pi] == '*') {
+			++pi;
+		}
+		return (pi == pn) != negate;
+	}
+
+	bool exceptionMgr::hit(lua_State* L, eException type)
+	{
+		auto filter = filters_.find(type);
+		if (filter == filters_.end()) {
+			return false;
+		}
+		size_t len = 0;
+		const char* msg = lua_type(L, -1) == LUA_TSTRING
+			? lua_tolstring(L, -1, &len)
+			: lua_typename(L, lua_type(L, -1));
+		if (!msg) {
+			msg = "";
+		}
+		else if (len == 0) {
+			len = strlen(msg);
+		}
+		if (!filter->second.empty() && !match(filter->second, msg, len)) {
+			return false;
+		}
+
+		// The site is the innermost Lua function, so errors raised by C
+		// functions are counted where they were called.
+		site_key key { 0, 0 };
+		lua::Debug ar;
+		for (int level = 0; lua_getstack(L, level, (lua_Debug*)&ar); ++level) {
+			if (lua_getinfo(L, "Sl", (lua_Debug*)&ar) && *ar.what != 'C' && lua_getinfo(L, "f", (lua_Debug*)&ar)) {
+				key.f = (intptr_t)lua_getprotohash(L, -1);
+				key.line = ar.currentline;
+				lua_pop(L, 1);
+				break;
+			}
+		}
+		auto it = sites_.find(key);
+		if (it != sites_.end() && key.f && it->second.source != ar.source) {
+			// A collected function whose memory was reused.
+			sites_.erase(it);
+			it = sites_.end();
+		}
+		if (it == sites_.end()) {
+			if (sites_.size() >= site_limit) {
+				if (stops_ == 0) {
+					untracked_++;
+					return true;
+				}
+				// exceptionSiteStops needs the site to be counted, so the
+				// least hit one makes room for it.
+				evict();
+			}
+			site s { key.f ? ar.source : "=[C]", key.line, 0, 0, std::string(msg, std::min(len, (size_t)256)) };
+			it = sites_.insert(std::make_pair(key, std::move(s))).first;
+		}
+		site& s = it->second;
+		s.hits++;
+		if (stops_ && s.stops >= stops_) {
+			return false;
+		}
+		s.stops++;
+		return true;
+	}
+
+	void exceptionMgr::output_sites(wprotocol& res, size_t count, std::function<void(const std::string&, wprotocol&)> source)
+	{
+		std::vector<const site*> top;
+		top.reserve(sites_.size());
+		uint64_t total = untracked_;
+		for (auto& s : sites_) {
+			top.push_back(&s.second);
+			total += s.second.hits;
+		}
+		if (count == 0 || count > top.size()) {
+			count = top.size();
+		}
+		std::partial_sort(top.begin(), top.begin() + count, top.end(), [](const site* a, const site* b) {
+			return a->hits > b->hits;
+		});
+		res("total").Uint64(total);
+		res("untracked").Uint64(untracked_);
+		for (auto _ : res("sites").Array())
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				for (auto _ : res.Object())
+				{
+					source(top[i]->source, res);
+					res("line").Int(top[i]->line);
+					res("hits").Uint64(top[i]->hits);
+					res("stops").Uint64(top[i]->stops);
+					res("message").String(top[i]->message);
+				}
+			}
+		}
+	}
+
+	// Its hits are kept in the untracked count.
+	void exceptionMgr::evict()
+	{
+		auto victim = std::min_element(sites_.begin(), sites_.end(), [](const std::pair<const site_key, site>& a, const std::pair<const site_key, site>& b) {
+			return a.second.hits < b.second.hits;
+		});
+		if (victim != sites_.end()) {
+			untracked_ += victim->second.hits;
+			sites_.erase(victim);
+		}
+	}
+
+	void exceptionMgr::reset_sites()
+	{
+		sites_.clear();
+		untracked_ = 0;
+	}
+
+	memory_usage exceptionMgr::site_usage() const
+	{
+		size_t bytes = 0;
+		for (auto& s : sites_) {
+			bytes += sizeof(s) + s.second.source.size() + s.second.message.size();
+		}
+		return { sites_.size(), bytes, site_limit };
+	}
+}
@@ -6,6 +6,8 @@
 #include <debugger/osthread.h>
 #include <debugger/luathread.h>
 #include <base/util/format.h>
+#include <algorithm>
+#include <inttypes.h>
 
 namespace vscode
 {
@@ -42,14 +44,6 @@ namespace vscode
 		return 0;
 	}
 
-	static lua_State* get_mainthread(lua_State* thread)
-	{
-		lua_rawgeti(thread, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
-		lua_State* ml = lua_tothread(thread, -1);
-		lua_pop(thread, 1);
-		return ml;
-	}
-
 	struct disable_hook {
 		disable_hook(lua_State* L)
 			: L(L)
@@ -69,6 +63,13 @@ namespace vscode
 		int count;
 	};
 
+	// Reported in currentline of LUA_HOOKEXCEPTION by a patched VM.
+#if !defined(LUA_EXCEPTION_LUAPCALL)
+#define LUA_EXCEPTION_LUAPCALL 0
+#define LUA_EXCEPTION_PCALL    1
+#define LUA_EXCEPTION_XPCALL   2
+#endif
+
 	enum class eCall {
 		none,
 		pcall,
@@ -103,43 +104,34 @@ namespace vscode
 
 	luathread* debugger_impl::find_luathread(lua_State* L)
 	{
-		L = get_mainthread(L);
-		for (auto& lt : luathreads_) {
-			if (lt.second->L == L) {
-				return lt.second.get();
-			}
-		}
-		return nullptr;
+		return luathreads_.find(L);
 	}
 
 	luathread* debugger_impl::find_luathread(int threadid)
 	{
-		auto it = luathreads_.find(threadid);
-		if (it != luathreads_.end()) {
-			return it->second.get();
-		}
-		return nullptr;
+		return luathreads_.find(threadid);
 	}
 
 	bool debugger_impl::attach_lua(lua_State* L)
 	{
 		if (nodebug_) return false;
+		std::lock_guard<osthread> lock(thread_);
 		luathread* thread = find_luathread(L);
 		if (thread) {
 			return !thread->enable_thread();
 		}
-		int new_threadid = ++next_threadid_;
-		std::unique_ptr<luathread> newthread(new luathread(new_threadid, *this, get_mainthread(L)));
-		luathreads_.insert(std::make_pair<int, std::unique_ptr<luathread>>(std::move(new_threadid), std::move(newthread)));
-		return true;
+		return luathreads_.create(*this, L) != nullptr;
 	}
 
 	void debugger_impl::detach_lua(lua_State* L, bool remove)
 	{
+		std::lock_guard<osthread> lock(thread_);
 		luathread* thread = find_luathread(L);
 		if (thread) {
 			if (remove) {
-				luathreads_.erase(thread->id);
+				update_redirect();
+				sourcemgr_.detach(L, true);
+				luathreads_.erase(thread);
 			}
 			else {
 				thread->disable_thread();
@@ -150,15 +142,16 @@ namespace vscode
 	void debugger_impl::detach_all(bool release)
 	{
 		if (release) {
-			for (auto& lt : luathreads_) {
-				lt.second->release_thread();
-				lt.second->disable_thread();
+			for (luathread* lt : luathreads_) {
+				lt->release_thread();
+				lt->disable_thread();
 			}
 			luathreads_.clear();
+			sourcemgr_.detach(nullptr, false);
 		}
 		else {
-			for (auto& lt : luathreads_) {
-				lt.second->disable_thread();
+			for (luathread* lt : luathreads_) {
+				lt->disable_thread();
 			}
 		}
 	}
@@ -187,6 +180,18 @@ namespace vscode
 
 	void debugger_impl::update_redirect()
 	{
+		uint64_t dropped = outputQueueDropped_.exchange(0, std::memory_order_relaxed);
+		if (dropped) {
+			outputDropped_ += dropped;
+			outputStats_.dropped_messages += dropped;
+			outputStats_.dropped_bytes += outputQueueDroppedBytes_.exchange(0, std::memory_order_relaxed);
+		}
+		size_t blockLimit = outputBlockLimit_.load(std::memory_order_relaxed);
+		for (luathread* thread : luathreads_) {
+			output_drain(thread->output, blockLimit);
+		}
+		output_drain(outputQueue_, blockLimit);
+		output_merge_flush(false);
 #if defined(_WIN32)
 		if (stdout_) {
 			size_t n = stdout_->peek();
@@ -207,6 +212,46 @@ namespace vscode
 #endif
 	}
 
+	// Under the block policy records stay queued while the send queue is
+	// full, so it never grows past outputLimit by more than one message.
+	void debugger_impl::output_drain(output_queue& queue, size_t blockLimit)
+	{
+		output_record rec;
+		while ((blockLimit == 0 || network_->send_size() < blockLimit) && queue.try_dequeue(rec)) {
+			source* s = nullptr;
+			if (!rec.code.empty()) {
+				// Later records of the chunk only carry its key, so its text
+				// is kept even if this one is discarded.
+				s = sourcemgr_.createByKey(rec.key, rec.code);
+			}
+			if (is_state(eState::terminated) || is_state(eState::birth) || is_state(eState::initialized)) {
+				continue;
+			}
+			if (consoleSourceCoding_ == eCoding::none) {
+				continue;
+			}
+			if (!output_admit(rec.category, rec.text.data(), rec.text.size())) {
+				continue;
+			}
+			if (!rec.chunkname.empty()) {
+				s = sourcemgr_.create(rec.chunkname.c_str());
+			}
+			else if (rec.key && !s) {
+				s = sourcemgr_.createByKey(rec.key, rec.code);
+			}
+			output_merge(rec.category, rec.text.data(), rec.text.size(), s, rec.line);
+		}
+	}
+
+	size_t debugger_impl::output_queued()
+	{
+		size_t n = outputQueue_.size_approx();
+		for (luathread* thread : luathreads_) {
+			n += thread->output.size_approx();
+		}
+		return n;
+	}
+
 	void debugger_impl::panic(luathread* thread, lua_State *L)
 	{
 		std::lock_guard<osthread> lock(thread_);
@@ -224,48 +269,112 @@ namespace vscode
 		luathread* thread = 0;
 	};
 
+	// While running with nothing to stop for, an event only touches the
+	// thread's own luathread, so it is handled without thread_ and threads
+	// running their own lua_State don't contend. What a stop depends on is
+	// either read atomically (state_, stopped_) or cached per thread and
+	// trusted only while epoch_ is unchanged; anything else takes the lock.
+	bool debugger_impl::hook_unlocked(luathread* thread, debug& debug)
+	{
+		eState state = state_.load(std::memory_order_acquire);
+		if (state == eState::terminated || state == eState::birth || state == eState::initialized) {
+			return true;
+		}
+		if (state != eState::running || thread->epoch != epoch_.load(std::memory_order_acquire)) {
+			return false;
+		}
+		if (stopped_.load(std::memory_order_acquire)) {
+			return false;
+		}
+		if (!thread->hook_running(debug)) {
+			return false;
+		}
+#if !defined(DEBUGGER_DISABLE_STATS)
+		eStat type;
+		switch (debug.event()) {
+		case LUA_HOOKCALL:
+		case LUA_HOOKTAILCALL: type = eStat::hook_call; break;
+		case LUA_HOOKRET:      type = eStat::hook_return; break;
+		case LUA_HOOKLINE:     type = eStat::hook_line; break;
+		case LUA_HOOKEXCEPTION: type = eStat::hook_exception; break;
+		default: return true;
+		}
+		thread->stats.unlocked[(size_t)type].add(1);
+#endif
+		return true;
+	}
+
 	void debugger_impl::hook(luathread* thread, debug& debug)
 	{
+		if (hook_unlocked(thread, debug)) {
+			return;
+		}
 		std::lock_guard<osthread> lock(thread_);
 		busy_guard busy(thread);
 
 		if (is_state(eState::terminated) || is_state(eState::birth) || is_state(eState::initialized)) {
 			return;
 		}
-		
+		uint32_t epoch = epoch_.load(std::memory_order_relaxed);
+		if (thread->epoch != epoch) {
+			thread->update_epoch(epoch, !exceptionmgr_.empty());
+		}
+
 		lua_State* L = debug.L();
+#if !defined(DEBUGGER_DISABLE_STATS)
+		thread->stats.events++;
+#endif
+		DEBUGGER_STATS_TIMER(timer, thread->stats.time, &stats_.hook_time);
 
-		if (debug.event() == LUA_HOOKCALL || debug.event() == LUA_HOOKTAILCALL || debug.event() == LUA_HOOKRET) {
+		if (debug.event() == LUA_HOOKCALL || debug.event() == LUA_HOOKTAILCALL) {
+			DEBUGGER_STATS_ADD(stats_, hook_call, 1);
+			thread->hook_callret(debug);
+			return;
+		}
+		if (debug.event() == LUA_HOOKRET) {
+			DEBUGGER_STATS_ADD(stats_, hook_return, 1);
 			thread->hook_callret(debug);
 			return;
 		}
 		if (debug.event() == LUA_HOOKEXCEPTION) {
-			switch (traceCall(L, 0)) {
-			case eCall::pcall:
-				exception_nolock(thread, L, eException::pcall, 0);
-				break;
-			case eCall::xpcall:
-				exception_nolock(thread, L, eException::xpcall, 0);
-				break;
-			case eCall::none:
+			DEBUGGER_STATS_ADD(stats_, hook_exception, 1);
+			DEBUGGER_STATS_CANCEL(timer);
+			if (exceptionmgr_.empty()) {
+				return;
+			}
+			eException type;
+			switch (debug.currentline()) {
+			case LUA_EXCEPTION_PCALL:    type = eException::pcall; break;
+			case LUA_EXCEPTION_XPCALL:   type = eException::xpcall; break;
+			case LUA_EXCEPTION_LUAPCALL: type = eException::lua_pcall; break;
 			default:
-				exception_nolock(thread, L, eException::lua_pcall, 0);
+				// A VM that does not classify the error: walk the stack.
+				switch (traceCall(L, 0)) {
+				case eCall::pcall:  type = eException::pcall; break;
+				case eCall::xpcall: type = eException::xpcall; break;
+				default:            type = eException::lua_pcall; break;
+				}
 				break;
 			}
+			exception_nolock(thread, L, type, 0);
 			return;
 		}
 		if (debug.event() != LUA_HOOKLINE) {
 			return;
 		}
+		DEBUGGER_STATS_ADD(stats_, hook_line, 1);
 		thread->hook_line(debug, breakpointmgr_);
 		if (!thread->cur_function) {
 			return;
 		}
 
+		// Time spent stopped is the user's, not the hook's.
 		if (debug.currentline() > 0 && thread->has_breakpoint && breakpointmgr_.has(thread->cur_function, debug.currentline(), debug)) {
+			DEBUGGER_STATS_CANCEL(timer);
 			run_stopped(thread, debug, "breakpoint");
 		}
 		else if (is_state(eState::stepping) && thread->check_step(L)) {
+			DEBUGGER_STATS_CANCEL(timer);
 			run_stopped(thread, debug, stopReason_.c_str());
 		}
 	}
@@ -273,9 +382,9 @@ namespace vscode
 	bool debugger_impl::exception(lua_State* L, eException exceptionType, int level)
 	{
 		if (!L) {
-			for (auto& lt : luathreads_) {
-				if (lt.second->busy) {
-					return exception(lt.second->L, exceptionType, level);
+			for (luathread* lt : luathreads_) {
+				if (lt->busy) {
+					return exception(lt->L, exceptionType, level);
 				}
 			}
 			return false;
@@ -308,7 +417,7 @@ namespace vscode
 
 	void debugger_impl::exception_nolock(luathread* thread, lua_State* L, eException exceptionType, int level)
 	{
-		if (exception_.find(exceptionType) == exception_.end())
+		if (!exceptionmgr_.hit(L, exceptionType))
 		{
 			return;
 		}
@@ -317,25 +426,40 @@ namespace vscode
 		if (lua_getstack(L, 0, (lua_Debug*)&ar))
 		{
 			lua_pushinteger(L, level);
+			debug d(L, &ar);
 			if (!hasFrame(L) && lua_type(L, -2) == LUA_TSTRING) {
-				run_stopped(thread, debug(L, &ar), "exception", lua_tostring(L, -2));
+				run_stopped(thread, d, "exception", lua_tostring(L, -2));
 			}
 			else {
-				run_stopped(thread, debug(L, &ar), "exception");
+				run_stopped(thread, d, "exception");
 			}
 			lua_pop(L, 1);
 		}
 	}
 
+	struct stopped_guard {
+		stopped_guard(std::atomic<int>& n) : n(n) {
+			n.fetch_add(1, std::memory_order_acq_rel);
+		}
+		~stopped_guard() {
+			n.fetch_sub(1, std::memory_order_acq_rel);
+		}
+		std::atomic<int>& n;
+	};
+
 	void debugger_impl::run_stopped(luathread* thread, debug& debug, const char* reason, const char* description)
 	{
+		stopped_guard stopped(stopped_);
+		update_redirect();
+		output_merge_flush(true);
 		event_stopped(thread, reason, description);
 
 		bool quit = false;
 		while (!quit)
 		{
 			update_redirect();
-			network_->update(0);
+			sourcemgr_.update(loadedSourceBatch_, loadedSourceLimit_);
+			network_update();
 
 			rprotocol req = io_input();
 			if (req.IsNull()) {
@@ -368,7 +492,12 @@ namespace vscode
 	void debugger_impl::run_idle()
 	{
 		update_redirect();
-		network_->update(0);
+		network_update();
+		if (is_state(eState::running) || is_state(eState::stepping)) {
+			output_flush();
+			sourcemgr_.update(loadedSourceBatch_, loadedSourceLimit_);
+			stats_dump();
+		}
 		if (is_state(eState::birth))
 		{
 			rprotocol req = io_input();
@@ -402,9 +531,42 @@ namespace vscode
 		else if (is_state(eState::terminated))
 		{
 			set_state(eState::birth);
+			wprotocol::default_encoding(eEncoding::json);
 		}
 	}
 
+	// Writes a one-line summary to the console every statsInterval ms.
+	void debugger_impl::stats_dump()
+	{
+#if !defined(DEBUGGER_DISABLE_STATS)
+		if (statsInterval_ <= 0) {
+			return;
+		}
+		auto now = std::chrono::steady_clock::now();
+		if (now - statsTime_ < std::chrono::milliseconds(statsInterval_)) {
+			return;
+		}
+		statsTime_ = now;
+		auto& c = stats_;
+		uint64_t lookups = c.get(eStat::get_function_hit) + c.get(eStat::get_function_miss);
+		uint64_t converts = c.get(eStat::path_convert_hit) + c.get(eStat::path_convert_miss);
+		std::string s = base::format("[debugger] hook %d events, p50 %dns, p99 %dns, max %dns; function cache %d/%d; path cache %d/%d; conditions %d; sent %dB, received %dB, send queue %dB, output queue %d\n"
+			, c.hook_time.count
+			, c.hook_time.percentile(0.5)
+			, c.hook_time.percentile(0.99)
+			, c.hook_time.max
+			, c.get(eStat::get_function_hit), lookups
+			, c.get(eStat::path_convert_hit), converts
+			, c.get(eStat::condition)
+			, c.get(eStat::bytes_sent)
+			, c.get(eStat::bytes_received)
+			, network_->send_size()
+			, output_queued()
+		);
+		output_event("console", s.data(), s.size());
+#endif
+	}
+
 	void debugger_impl::update()
 	{
 		std::unique_lock<osthread> lock(thread_, std::try_to_lock_t());
@@ -432,10 +594,111 @@ namespace vscode
 		custom_ = custom;
 	}
 
+	void debugger_impl::network_update()
+	{
+		network_->update(0);
+		sendBacklog_.store(network_->send_size(), std::memory_order_relaxed);
+	}
+
+	// The block policy holds a printing thread back here until the send
+	// queue has drained. thread_ is only taken for a non-blocking network
+	// update at a time, so other threads keep running while this one waits,
+	// and the session closing releases the wait.
+	void debugger_impl::output_wait()
+	{
+		size_t limit = outputBlockLimit_.load(std::memory_order_relaxed);
+		if (limit == 0) {
+			return;
+		}
+		while (sendBacklog_.load(std::memory_order_relaxed) >= limit) {
+			eState state = state_.load(std::memory_order_acquire);
+			if (state != eState::running && state != eState::stepping) {
+				return;
+			}
+			{
+				std::unique_lock<osthread> lock(thread_, std::try_to_lock_t());
+				if (lock) {
+					network_update();
+				}
+			}
+			if (sendBacklog_.load(std::memory_order_relaxed) >= limit) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+	// Records a queue holds before output_enqueue applies outputPolicy.
+	static const size_t output_queue_limit = 4096;
+
+	// Called on a Lua thread. The record is encoded and sent by whoever next
+	// holds thread_ (see update_redirect), so the caller only pays for the
+	// copy, into the queue of its own luathread; only output of a state
+	// that is not attached shares a queue. An in-memory chunk is queued by
+	// content key, and its text only with the first output of a function.
 	void debugger_impl::threadsafe_output(const char* category, const char* buf, size_t len, lua_State* L, lua::Debug* ar)
 	{
-		std::lock_guard<osthread> lock(thread_);
-		return output(category, buf, len, L, ar);
+		output_wait();
+		output_record rec { category, std::string(buf, len), std::string(), 0, std::string(), 0 };
+		lua::Debug entry;
+		bool seen = true;
+		if (L) {
+			if (!ar && lua_getstack(L, 1, (lua_Debug*)&entry)) {
+				ar = &entry;
+			}
+			if (ar && lua_getinfo(L, "Sl", (lua_Debug*)ar) && *ar->what != 'C') {
+				rec.line = ar->currentline;
+				if (ar->source[0] == '@' || ar->source[0] == '=') {
+					rec.chunkname = ar->source;
+				}
+				else if (sourcemgr_.outputKey(L, ar, rec.key, rec.code)) {
+					seen = rec.code.empty();
+				}
+			}
+		}
+		luathread* thread = L ? luathread::get(L) : nullptr;
+		bool queued;
+		if (thread) {
+			queued = output_enqueue(thread->output, rec);
+		}
+		else {
+			std::lock_guard<std::mutex> lock(outputQueueMtx_);
+			queued = output_enqueue(outputQueue_, rec);
+		}
+		if (queued && !seen) {
+			sourcemgr_.outputSeen(L, ar, rec.key);
+		}
+	}
+
+	// A full queue grows while output is not limited. Under the block
+	// policy the caller waits for it to drain instead, helping when thread_
+	// is free (or held by this very thread, stopped and evaluating a print).
+	// The other policies let it grow until the send queue is over
+	// outputLimit, and then drop the record, reported like other drops.
+	bool debugger_impl::output_enqueue(output_queue& queue, output_record& rec)
+	{
+		size_t blockLimit = outputBlockLimit_.load(std::memory_order_relaxed);
+		size_t dropLimit = outputDropLimit_.load(std::memory_order_relaxed);
+		if (queue.size_approx() < output_queue_limit || (blockLimit == 0 && (dropLimit == 0 || sendBacklog_.load(std::memory_order_relaxed) < dropLimit))) {
+			return queue.enqueue(std::move(rec));
+		}
+		if (blockLimit) {
+			while (queue.size_approx() >= output_queue_limit) {
+				{
+					std::unique_lock<osthread> lock(thread_, std::try_to_lock_t());
+					if (lock) {
+						network_update();
+						update_redirect();
+					}
+				}
+				if (queue.size_approx() >= output_queue_limit) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+			return queue.enqueue(std::move(rec));
+		}
+		outputQueueDropped_.fetch_add(1, std::memory_order_relaxed);
+		outputQueueDroppedBytes_.fetch_add(rec.text.size(), std::memory_order_relaxed);
+		return false;
 	}
 
 	void debugger_impl::output(const char* category, const char* buf, size_t len, lua_State* L, lua::Debug* ar)
@@ -446,6 +709,178 @@ namespace vscode
 		if (consoleSourceCoding_ == eCoding::none) {
 			return;
 		}
+		if (!output_admit(category, buf, len)) {
+			return;
+		}
+		int line = 0;
+		source* s = output_source(L, ar, line);
+		output_merge(category, buf, len, s, line);
+	}
+
+	source* debugger_impl::output_source(lua_State* L, lua::Debug* ar, int& line)
+	{
+		if (!L) {
+			return nullptr;
+		}
+		lua::Debug entry;
+		if (!ar && lua_getstack(L, 1, (lua_Debug*)&entry)) {
+			ar = &entry;
+		}
+		if (!ar) {
+			return nullptr;
+		}
+		int status = lua_getinfo(L, "Sln", (lua_Debug*)ar);
+		assert(status);
+		if (*ar->what == 'C') {
+			return nullptr;
+		}
+		line = ar->currentline;
+		return sourcemgr_.create(ar, L);
+	}
+
+	// Applies outputLimit to an output event while the send queue is backed
+	// up. Returns false if the text was dropped or held back for coalescing.
+	// The block policy never waits here, with thread_ held: printing threads
+	// already waited in output_wait.
+	bool debugger_impl::output_admit(const char* category, const char* buf, size_t len)
+	{
+		if (outputLimit_ == 0 || outputPolicy_ == eOutputPolicy::block) {
+			return true;
+		}
+		output_flush();
+		if (network_->send_size() < outputLimit_) {
+			return true;
+		}
+		if (outputPolicy_ == eOutputPolicy::coalesce && outputCoalescedSize_ + len <= outputLimit_) {
+			if (outputCoalesced_.empty() || outputCoalesced_.back().first != category) {
+				outputCoalesced_.emplace_back(category, std::string());
+			}
+			outputCoalesced_.back().second.append(buf, len);
+			outputCoalescedSize_ += len;
+			outputStats_.coalesced_bytes += len;
+			return false;
+		}
+		outputDropped_++;
+		outputStats_.dropped_messages++;
+		outputStats_.dropped_bytes += len;
+		return false;
+	}
+
+	// Sends what output_admit held back, once the send queue has drained.
+	void debugger_impl::output_flush()
+	{
+		if (outputCoalesced_.empty() && !outputDropped_) {
+			return;
+		}
+		if (network_->send_size() >= outputLimit_) {
+			return;
+		}
+		sourcemap_t coalesced;
+		coalesced.swap(outputCoalesced_);
+		outputCoalescedSize_ = 0;
+		for (auto& text : coalesced) {
+			output_event(text.first.c_str(), text.second.data(), text.second.size());
+		}
+		if (outputDropped_) {
+			std::string marker = base::format("[%" PRIu64 " output messages dropped]\n", outputDropped_);
+			outputDropped_ = 0;
+			output_event("console", marker.data(), marker.size());
+		}
+	}
+
+	// Appends to the pending output while it has the same category and
+	// source and is younger than outputMergeWindow milliseconds.
+	void debugger_impl::output_merge(const char* category, const char* buf, size_t len, source* s, int line)
+	{
+		if (outputMergeWindow_ <= 0) {
+			output_limited(category, buf, len, s, line);
+			return;
+		}
+		auto now = std::chrono::steady_clock::now();
+		output_pending& p = outputPending_;
+		if (!p.text.empty()
+			&& p.category == category
+			&& p.src == s
+			&& p.text.size() + len <= outputMergeBytes_
+			&& now - p.time < std::chrono::milliseconds(outputMergeWindow_))
+		{
+			p.text.append(buf, len);
+			outputStats_.merged_messages++;
+			return;
+		}
+		output_pending_flush();
+		p.category = category;
+		p.text.assign(buf, len);
+		p.src = s;
+		p.line = line;
+		p.time = now;
+	}
+
+	// Sends the pending output once its window has passed, or right away when
+	// forced (before a stop or on close), along with the suppressed lines
+	// marker that would otherwise wait for the next output.
+	void debugger_impl::output_merge_flush(bool force)
+	{
+		output_pending& p = outputPending_;
+		if (!p.text.empty() && (force || std::chrono::steady_clock::now() - p.time >= std::chrono::milliseconds(outputMergeWindow_))) {
+			output_pending_flush();
+		}
+		output_suppressed_flush(force);
+	}
+
+	void debugger_impl::output_pending_flush()
+	{
+		output_pending& p = outputPending_;
+		if (p.text.empty()) {
+			return;
+		}
+		std::string text;
+		text.swap(p.text);
+		output_limited(p.category.c_str(), text.data(), text.size(), p.src, p.line);
+	}
+
+	void debugger_impl::output_suppressed_flush(bool force)
+	{
+		if (!outputSuppressed_) {
+			return;
+		}
+		if (!force && std::chrono::steady_clock::now() - outputRateTime_ < std::chrono::seconds(1)) {
+			return;
+		}
+		std::string marker = base::format("[%" PRIu64 " lines suppressed]\n", outputSuppressed_);
+		outputSuppressed_ = 0;
+		output_event("console", marker.data(), marker.size());
+	}
+
+	// Applies outputRate: output events beyond the ceiling within one second
+	// are counted and reported as a single line when the next second starts.
+	void debugger_impl::output_limited(const char* category, const char* buf, size_t len, source* s, int line)
+	{
+		if (outputRate_ == 0) {
+			output_event(category, buf, len, s, line);
+			return;
+		}
+		auto now = std::chrono::steady_clock::now();
+		if (now - outputRateTime_ >= std::chrono::seconds(1)) {
+			outputRateTime_ = now;
+			outputRateCount_ = 0;
+			output_suppressed_flush(true);
+		}
+		if (outputRateCount_ >= outputRate_) {
+			size_t lines = std::count(buf, buf + len, '\n');
+			if (len && buf[len - 1] != '\n') {
+				lines++;
+			}
+			outputSuppressed_ += lines;
+			outputStats_.suppressed_lines += lines;
+			return;
+		}
+		outputRateCount_++;
+		output_event(category, buf, len, s, line);
+	}
+
+	void debugger_impl::output_event(const char* category, const char* buf, size_t len, source* s, int line)
+	{
 		wprotocol res;
 		for (auto _ : res.Object())
 		{
@@ -466,22 +901,9 @@ namespace vscode
 					res("output").String(base::u2a(base::strview(buf, len)));
 				}
 
-				if (L) {
-					lua::Debug entry;
-					if (!ar && lua_getstack(L, 1, (lua_Debug*)&entry)) {
-						ar = &entry;
-					}
-					if (!ar) continue;
-
-					int status = lua_getinfo(L, "Sln", (lua_Debug*)ar);
-					assert(status);
-					if (*ar->what != 'C') {
-						source* s = sourcemgr_.create(ar);
-						if (s && s->valid) {
-							s->output(res);
-							res("line").Int(ar->currentline);
-						}
-					}
+				if (s && s->valid) {
+					s->output(res);
+					res("line").Int(line);
 				}
 			}
 		}
@@ -539,12 +961,25 @@ namespace vscode
 
 	void debugger_impl::io_output(const wprotocol& wp)
 	{
+		DEBUGGER_STATS_ADD(stats_, messages_sent, 1);
+		DEBUGGER_STATS_ADD(stats_, bytes_sent, wp.size());
 		vscode::io_output(network_, wp);
+		sendBacklog_.store(network_->send_size(), std::memory_order_relaxed);
 	}
 
 	rprotocol debugger_impl::io_input()
 	{
+#if defined(DEBUGGER_DISABLE_STATS)
 		return vscode::io_input(network_, &schema_);
+#else
+		size_t len = 0;
+		rprotocol req = vscode::io_input(network_, &schema_, &len);
+		if (len) {
+			DEBUGGER_STATS_ADD(stats_, messages_received, 1);
+			DEBUGGER_STATS_ADD(stats_, bytes_received, len);
+		}
+		return req;
+#endif
 	}
 
 	void debugger_impl::io_close() 
@@ -589,39 +1024,81 @@ namespace vscode
 
 	void debugger_impl::event(const char* name, lua_State* L, int argf, int argl)
 	{
-		luathread* thread = find_luathread(L);
-		if (!thread) {
-			return;
-		}
 		if (strcmp(name, "call") == 0) {
-			source* s = sourcemgr_.createByRef(luaL_checkstring(L, argf));
-			if (argf < argl) {
-				s->name = luaL_checkstring(L, argf + 1);
-			}
-			vdebugmgr_.event_call(s);
-			thread->dbg.hook(thread, debug::event_call(L));
+			size_t len = 0;
+			const char* code = luaL_checklstring(L, argf, &len);
+			const char* vname = argf < argl ? luaL_checkstring(L, argf + 1) : nullptr;
+			vcall(L, vsource(code, len, vname));
 		}
 		else if (strcmp(name, "return") == 0) {
-			vdebugmgr_.event_return();
-			thread->dbg.hook(thread, debug::event_return(L));
+			vreturn(L);
 		}
 		else if (strcmp(name, "line") == 0) {
+			int line = (int)luaL_checkinteger(L, argf);
 			if (argf == argl) {
-				thread->dbg.hook(thread, debug::event_line(L, (int)luaL_checkinteger(L, argf), -1));
+				vline(L, line, -1);
 			}
 			else {
 				luaL_checktype(L, argf + 1, LUA_TTABLE);
-				thread->dbg.hook(thread, debug::event_line(L, (int)luaL_checkinteger(L, argf), lua_absindex(L, argf + 1)));
+				vline(L, line, lua_absindex(L, argf + 1));
 			}
 		}
 	}
 
-	source* debugger_impl::createSource(lua::Debug* ar) {
-		return sourcemgr_.create(ar);
+	// Registers the text of a virtual source once; the handle is then passed
+	// to vcall, so events do no string work.
+	int debugger_impl::vsource(const char* code, size_t len, const char* name)
+	{
+		std::lock_guard<osthread> lock(thread_);
+		source* s = sourcemgr_.createByRef(code, len);
+		if (name) {
+			s->name = name;
+		}
+		return vdebugmgr_.add_source(s);
+	}
+
+	bool debugger_impl::vcall(lua_State* L, int handle)
+	{
+		std::lock_guard<osthread> lock(thread_);
+		source* s = vdebugmgr_.find_source(handle);
+		if (!s) {
+			return false;
+		}
+		luathread* thread = find_luathread(L);
+		if (!thread) {
+			return true;
+		}
+		vdebugmgr_.event_call(s);
+		debug d = debug::event_call(L, vdebugmgr_);
+		thread->dbg.hook(thread, d);
+		return true;
 	}
 
-	bool debugger_impl::getCode(uint32_t ref, std::string& code) {
-		return sourcemgr_.getCode(ref, code);
+	void debugger_impl::vreturn(lua_State* L)
+	{
+		std::lock_guard<osthread> lock(thread_);
+		luathread* thread = find_luathread(L);
+		if (!thread) {
+			return;
+		}
+		vdebugmgr_.event_return();
+		debug d = debug::event_return(L, vdebugmgr_);
+		thread->dbg.hook(thread, d);
+	}
+
+	void debugger_impl::vline(lua_State* L, int line, int scope)
+	{
+		std::lock_guard<osthread> lock(thread_);
+		luathread* thread = find_luathread(L);
+		if (!thread) {
+			return;
+		}
+		debug d = debug::event_line(L, vdebugmgr_, line, scope);
+		thread->dbg.hook(thread, d);
+	}
+
+	source* debugger_impl::createSource(lua::Debug* ar, lua_State* L, int fidx) {
+		return sourcemgr_.create(ar, L, fidx);
 	}
 
 	source* debugger_impl::openVSource() {
@@ -638,26 +1115,14 @@ namespace vscode
 #define DBG_REQUEST_HOOK(name) std::bind(&debugger_impl::name, this, std::placeholders::_1, std::placeholders::_2)
 
 	debugger_impl::debugger_impl(io::base* io)
-		: seq(1)
-		, network_(io)
-		, state_(eState::birth)
-		, breakpointmgr_(*this)
-		, sourcemgr_(*this)
-		, custom_(nullptr)
-		, exception_()
-		, luathreads_()
-		, on_clientattach_()
+		: custom_(nullptr)
 		, consoleSourceCoding_(eCoding::none)
 		, consoleTargetCoding_(eCoding::utf8)
 		, sourceCoding_(eCoding::ansi)
 		, workspaceFolder_()
+		, on_clientattach_()
 		, nodebug_(false)
-		, thread_(this)
-		, next_threadid_(0)
 		, translator_(nullptr)
-		, stopReason_("step")
-		, redirectL_(nullptr)
-		, attach_(true)
 		, main_dispatch_
 		({
 			{ "launch", DBG_REQUEST_MAIN(request_launch) },
@@ -668,6 +1133,8 @@ namespace vscode
 			{ "setBreakpoints", DBG_REQUEST_MAIN(request_set_breakpoints) },
 			{ "setExceptionBreakpoints", DBG_REQUEST_MAIN(request_set_exception_breakpoints) },
 			{ "pause", DBG_REQUEST_MAIN(request_pause) },
+			{ "debuggerStats", DBG_REQUEST_MAIN(request_debugger_stats) },
+			{ "exceptionSites", DBG_REQUEST_MAIN(request_exception_sites) },
 		})
 		, hook_dispatch_
 		({
@@ -685,10 +1152,64 @@ namespace vscode
 			{ "exceptionInfo", DBG_REQUEST_HOOK(request_exception_info) },
 			{ "loadedSources", DBG_REQUEST_HOOK(request_loaded_sources) },
 		})
+		, thread_(this)
+		, network_(io)
+		, breakpointmgr_(*this)
+		, sourcemgr_(*this)
+		, luathreads_()
+		, seq(1)
+		, state_(eState::birth)
+		, epoch_(1)
+		, stopped_(0)
+		, stopReason_("step")
+		, redirectL_(nullptr)
+		, attach_(true)
+		, outputPolicy_(eOutputPolicy::drop)
+		, outputLimit_(0)
+		, outputBlockLimit_(0)
+		, sendBacklog_(0)
+		, outputCoalesced_()
+		, outputCoalescedSize_(0)
+		, outputDropped_(0)
+		, outputStats_()
+		, outputQueue_(output_queue_limit)
+		, outputDropLimit_(0)
+		, outputQueueDropped_(0)
+		, outputQueueDroppedBytes_(0)
+		, outputPending_()
+		, outputMergeWindow_(0)
+		, outputMergeBytes_(0)
+		, outputRate_(0)
+		, outputRateCount_(0)
+		, outputSuppressed_(0)
+		, outputRateTime_()
+		, loadedSourceBatch_(0)
+		, loadedSourceLimit_(0)
+		, stats_()
+		, statsInterval_(0)
+		, statsTime_()
+		, variableLimit_(0xFFFF)
+		, watchLimit_(0)
+		, threadLimit_(1000)
 	{
 		config_.init(2, R"({
 			"consoleCoding" : "utf8",
-			"sourceCoding" : "ansi"
+			"sourceCoding" : "ansi",
+			"outputLimit" : 16777216,
+			"outputPolicy" : "drop",
+			"outputMergeWindow" : 5,
+			"outputMergeBytes" : 65536,
+			"outputRate" : 1000,
+			"loadedSourceBatch" : 100,
+			"loadedSourceLimit" : 10000,
+			"statsInterval" : 0,
+			"sourceCodeLimit" : 67108864,
+			"pathCacheLimit" : 65536,
+			"functionCacheLimit" : 262144,
+			"variableLimit" : 65535,
+			"watchLimit" : 1024,
+			"exceptionSiteStops" : 0,
+			"threadLimit" : 1000
 		})");
 		thread_.start();
 		network_->on_close_event(debugger_on_disconnect, this);
@@ -19,6 +19,16 @@ static void log(const char* fmt, const Args& ... args)
 	OutputDebugStringA(s.c_str());
 }
 
+// Messages are logged as JSON text whatever their wire encoding.
+static std::string log_json(const char* buf, size_t len)
+{
+	std::string s(buf, len);
+	if (!vscode::cbor::to_json(s)) {
+		return "<invalid CBOR>";
+	}
+	return s;
+}
+
 #endif	 
 
 namespace vscode {
@@ -108,14 +118,26 @@ namespace vscode {
 		return !!doc;
 	}
 
-	rprotocol io_input(io::base* io, schema* schema)
+	rprotocol io_input(io::base* io, schema* schema, size_t* len)
 	{
 		std::string buf;
 		if (!io->input(buf)) {
 			return rprotocol();
 		}
+		if (len) {
+			*len = buf.size();
+		}
 		rapidjson::Document	d;
-		if (d.Parse(buf.data(), buf.size()).HasParseError())
+		if (cbor::is_cbor(buf.data(), buf.size()))
+		{
+			if (!cbor::parse(buf.data(), buf.size(), d))
+			{
+				log("Input is not a valid CBOR\n");
+				io->close();
+				return rprotocol();
+			}
+		}
+		else if (d.Parse(buf.data(), buf.size()).HasParseError())
 		{
 			log("Input is not a valid JSON\n");
 			log("Error(offset %u): %s\n", static_cast<unsigned>(d.GetErrorOffset()), rapidjson::GetParseError_En(d.GetParseError()));
@@ -127,7 +149,7 @@ namespace vscode {
 			io->close();
 			return rprotocol();
 		}
-		log("%s\n", buf.data());
+		log("%s\n", log_json(buf.data(), buf.size()).c_str());
 		return rprotocol(std::move(d));
 	}
 
@@ -137,9 +159,10 @@ namespace vscode {
 			return;
 		if (!io->output(wp.data(), wp.size()))
 			return;
-		log("%s\n", wp.data());
+		log("%s\n", log_json(wp.data(), wp.size()).c_str());
 	}
 
+	// Always JSON, whatever the input encoding was; the debugger reads both.
 	void io_output(io::base* io, const rprotocol& rp)
 	{
 		rapidjson::StringBuffer buffer;
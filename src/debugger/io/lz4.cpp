@@ -0,0 +1,154 @@
+#include <debugger/io/lz4.h>
+#include <string.h>
+
+namespace vscode { namespace io { namespace lz4 {
+	enum {
+		min_match = 4,
+		last_literals = 5,
+		mf_limit = 12,
+		max_distance = 65535,
+		max_frame = 256 * 1024 * 1024,
+	};
+
+	static uint32_t read32(const uint8_t* p) {
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static uint32_t hash(uint32_t v) {
+		return (v * 2654435761u) >> (32 - hash_log);
+	}
+
+	static void put_length(std::string& out, size_t n) {
+		for (; n >= 255; n -= 255) {
+			out.push_back((char)255);
+		}
+		out.push_back((char)n);
+	}
+
+	static void put_sequence(std::string& out, const uint8_t* lit, size_t litlen, size_t offset, size_t matchlen) {
+		size_t ml = matchlen - min_match;
+		uint8_t token = (uint8_t)((litlen < 15 ? litlen : 15) << 4);
+		if (matchlen) {
+			token |= (uint8_t)(ml < 15 ? ml : 15);
+		}
+		out.push_back((char)token);
+		if (litlen >= 15) {
+			put_length(out, litlen - 15);
+		}
+		out.append((const char*)lit, litlen);
+		if (!matchlen) {
+			return;
+		}
+		out.push_back((char)(offset & 0xff));
+		out.push_back((char)(offset >> 8));
+		if (ml >= 15) {
+			put_length(out, ml - 15);
+		}
+	}
+
+	void compress(context& ctx, const char* src, size_t len, std::string& out) {
+		uint32_t n = (uint32_t)len;
+		out.append((const char*)&n, sizeof(n));
+		out.reserve(out.size() + len / 2);
+
+		const uint8_t* base = (const uint8_t*)src;
+		const uint8_t* ip = base;
+		const uint8_t* anchor = base;
+		const uint8_t* iend = base + len;
+
+		if (len > mf_limit) {
+			const uint8_t* mflimit = iend - mf_limit;
+			const uint8_t* matchlimit = iend - last_literals;
+			memset(ctx.table, 0, sizeof(ctx.table));
+			ctx.table[hash(read32(ip))] = 0;
+			ip++;
+			size_t misses = 0;
+			while (ip < mflimit) {
+				uint32_t h = hash(read32(ip));
+				const uint8_t* ref = base + ctx.table[h];
+				ctx.table[h] = (uint32_t)(ip - base);
+				if (ref >= ip || ip - ref > max_distance || read32(ref) != read32(ip)) {
+					// Skip faster through data that does not compress.
+					ip += 1 + (misses++ >> 6);
+					continue;
+				}
+				misses = 0;
+				while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+					ip--;
+					ref--;
+				}
+				const uint8_t* mp = ip + min_match;
+				const uint8_t* rp = ref + min_match;
+				while (mp < matchlimit && *mp == *rp) {
+					mp++;
+					rp++;
+				}
+				put_sequence(out, anchor, ip - anchor, ip - ref, mp - ip);
+				ip = anchor = mp;
+				if (ip < mflimit) {
+					ctx.table[hash(read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+				}
+			}
+		}
+		put_sequence(out, anchor, iend - anchor, 0, 0);
+	}
+
+	static bool get_length(const uint8_t*& ip, const uint8_t* iend, size_t& n) {
+		for (;;) {
+			if (ip >= iend) return false;
+			uint8_t b = *ip++;
+			n += b;
+			if (b != 255) return true;
+		}
+	}
+
+	bool decompress(const char* src, size_t len, std::string& out) {
+		uint32_t rawlen;
+		if (len < sizeof(rawlen)) {
+			return false;
+		}
+		memcpy(&rawlen, src, sizeof(rawlen));
+		if (rawlen > max_frame) {
+			return false;
+		}
+		out.resize(rawlen);
+		uint8_t* op = (uint8_t*)&out[0];
+		uint8_t* oend = op + rawlen;
+		const uint8_t* ip = (const uint8_t*)src + sizeof(rawlen);
+		const uint8_t* iend = (const uint8_t*)src + len;
+
+		while (ip < iend) {
+			uint8_t token = *ip++;
+			size_t litlen = token >> 4;
+			if (litlen == 15 && !get_length(ip, iend, litlen)) return false;
+			if ((size_t)(iend - ip) < litlen || (size_t)(oend - op) < litlen) return false;
+			memcpy(op, ip, litlen);
+			op += litlen;
+			ip += litlen;
+			if (ip == iend) {
+				break;
+			}
+			if (iend - ip < 2) return false;
+			size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > (size_t)(op - (uint8_t*)&out[0])) return false;
+			size_t matchlen = token & 15;
+			if (matchlen == 15 && !get_length(ip, iend, matchlen)) return false;
+			matchlen += min_match;
+			if ((size_t)(oend - op) < matchlen) return false;
+			const uint8_t* ref = op - offset;
+			if (offset >= matchlen) {
+				memcpy(op, ref, matchlen);
+				op += matchlen;
+			}
+			else {
+				for (size_t i = 0; i < matchlen; ++i) {
+					*op++ = *ref++;
+				}
+			}
+		}
+		return op == oend;
+	}
+}}}
@@ -0,0 +1,103 @@
+#include <debugger/io/recorder.h>
+#include <chrono>
+#include <inttypes.h>
+
+namespace vscode { namespace io {
+	uint64_t record_clock()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	recorder::recorder(base* io, const char* path)
+		: io_(io)
+		, file_(fopen(path, "wb"))
+		, start_(record_clock())
+	{ }
+
+	recorder::~recorder()
+	{
+		if (file_) {
+			fclose(file_);
+		}
+	}
+
+	void recorder::update(int ms)
+	{
+		io_->update(ms);
+	}
+
+	bool recorder::output(const char* buf, size_t len)
+	{
+		write(false, buf, len);
+		return io_->output(buf, len);
+	}
+
+	bool recorder::input(std::string& buf)
+	{
+		if (!io_->input(buf)) {
+			return false;
+		}
+		write(true, buf.data(), buf.size());
+		return true;
+	}
+
+	void recorder::close()
+	{
+		io_->close();
+		if (file_) {
+			fflush(file_);
+		}
+	}
+
+	void recorder::on_close_event(CloseEvent fn, void* ud)
+	{
+		io_->on_close_event(fn, ud);
+	}
+
+	size_t recorder::send_size()
+	{
+		return io_->send_size();
+	}
+
+	void recorder::write(bool in, const char* buf, size_t len)
+	{
+		if (!file_) {
+			return;
+		}
+		fprintf(file_, "%" PRIu64 " %s %zu\n", record_clock() - start_, in ? "in" : "out", len);
+		fwrite(buf, 1, len, file_);
+		fputc('\n', file_);
+		fflush(file_);
+	}
+
+	bool read_recording(const char* path, std::vector<record_entry>& entries)
+	{
+		FILE* f = fopen(path, "rb");
+		if (!f) {
+			return false;
+		}
+		bool ok = true;
+		for (;;) {
+			uint64_t time;
+			char dir[4];
+			size_t len;
+			int n = fscanf(f, "%" SCNu64 " %3s %zu", &time, dir, &len);
+			if (n == EOF) {
+				break;
+			}
+			if (n != 3 || fgetc(f) != '\n') {
+				ok = false;
+				break;
+			}
+			record_entry e { time, dir[0] == 'i', std::string(len, '\0') };
+			if (len && fread(&e.data[0], 1, len, f) != len) {
+				ok = false;
+				break;
+			}
+			fgetc(f);
+			entries.push_back(std::move(e));
+		}
+		fclose(f);
+		return ok;
+	}
+}}
@@ -0,0 +1,459 @@
+#include <debugger/io/shm.h>
+
+#if !defined(_WIN32)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <limits.h>
+#endif
+
+namespace vscode { namespace io {
+	enum : uint32_t {
+		shm_magic = 0x4742444c,
+		shm_ring_size = 1 << 20,
+	};
+
+	enum shm_state : uint32_t {
+		shm_idle,
+		shm_claimed,
+		shm_connected,
+		shm_detached,
+	};
+
+	// head/tail are free-running byte counters; shm_ring_size divides 2^32,
+	// so head - tail is the number of readable bytes even after they wrap.
+	struct shm_ring {
+		alignas(64) std::atomic<uint32_t> head;
+		alignas(64) std::atomic<uint32_t> tail;
+		alignas(64) std::atomic<uint32_t> seq;
+		std::atomic<uint32_t> waiters;
+		char data[shm_ring_size];
+	};
+
+	struct shm_region {
+		std::atomic<uint32_t> magic;
+		std::atomic<uint32_t> state;
+		std::atomic<int32_t>  server;
+		std::atomic<int32_t>  client;
+		shm_ring ring[2];
+	};
+	static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory rings need lock-free atomics");
+
+	static std::string shm_path(std::string const& name) {
+		return name[0] == '/' ? name : "/" + name;
+	}
+
+	static bool process_alive(int32_t pid) {
+		return pid > 0 && (::kill(pid, 0) == 0 || errno == EPERM);
+	}
+
+	static void futex_wait(std::atomic<uint32_t>* addr, uint32_t val, int ms) {
+#if defined(__linux__)
+		struct timespec ts;
+		ts.tv_sec = ms / 1000;
+		ts.tv_nsec = (ms % 1000) * 1000000;
+		::syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, val, &ts, nullptr, 0);
+#else
+		for (int i = 0; i < ms && addr->load() == val; ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+#endif
+	}
+
+	static void futex_wake(std::atomic<uint32_t>* addr) {
+#if defined(__linux__)
+		::syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+	}
+
+	static shm_region* shm_map(int fd) {
+		void* p = ::mmap(nullptr, sizeof(shm_region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		return p == MAP_FAILED ? nullptr : (shm_region*)p;
+	}
+
+	static shm_region* shm_attach(std::string const& path) {
+		int fd = ::shm_open(path.c_str(), O_RDWR, 0);
+		if (fd == -1) {
+			return nullptr;
+		}
+		struct stat st;
+		if (::fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(shm_region)) {
+			::close(fd);
+			return nullptr;
+		}
+		shm_region* r = shm_map(fd);
+		if (r && r->magic.load(std::memory_order_acquire) != shm_magic) {
+			::munmap(r, sizeof(shm_region));
+			return nullptr;
+		}
+		return r;
+	}
+
+	shm::shm()
+	{ }
+
+	shm::~shm()
+	{
+		close();
+		if (!region_) {
+			return;
+		}
+		if (server_) {
+			region_->magic.store(0, std::memory_order_release);
+			region_->server.store(0);
+			::shm_unlink(name_.c_str());
+		}
+		::munmap(region_, sizeof(shm_region));
+	}
+
+	// A name still held by a live server is kept, and update tries again
+	// until it is released.
+	bool shm::open_server(std::string const& name) {
+		if (region_ || name.empty()) {
+			return false;
+		}
+		server_ = true;
+		name_ = shm_path(name);
+		return listen();
+	}
+
+	bool shm::listen() {
+		if (shm_region* old = shm_attach(name_)) {
+			bool busy = process_alive(old->server.load());
+			::munmap(old, sizeof(shm_region));
+			if (busy) {
+				return false;
+			}
+		}
+		::shm_unlink(name_.c_str());
+		int fd = ::shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+		if (fd == -1) {
+			return false;
+		}
+		if (::ftruncate(fd, sizeof(shm_region)) == -1) {
+			::close(fd);
+			::shm_unlink(name_.c_str());
+			return false;
+		}
+		region_ = shm_map(fd);
+		if (!region_) {
+			::shm_unlink(name_.c_str());
+			return false;
+		}
+		region_->state.store(shm_idle);
+		region_->client.store(0);
+		region_->server.store((int32_t)::getpid());
+		region_->magic.store(shm_magic, std::memory_order_release);
+		return true;
+	}
+
+	bool shm::open_client(std::string const& name) {
+		if (region_ || name.empty()) {
+			return false;
+		}
+		server_ = false;
+		name_ = shm_path(name);
+		return attach();
+	}
+
+	// Client side: claim the free slot. The server acknowledges by moving the
+	// state to connected after it has reset both rings.
+	bool shm::attach() {
+		shm_region* r = shm_attach(name_);
+		if (!r) {
+			return false;
+		}
+		int32_t expected = 0;
+		if (!r->client.compare_exchange_strong(expected, (int32_t)::getpid())) {
+			::munmap(r, sizeof(shm_region));
+			return false;
+		}
+		r->state.store(shm_claimed, std::memory_order_release);
+		region_ = r;
+		return true;
+	}
+
+	void shm::detach() {
+		if (server_) {
+			region_->state.store(shm_idle, std::memory_order_release);
+			region_->client.store(0);
+			return;
+		}
+		uint32_t st = shm_connected;
+		if (!region_->state.compare_exchange_strong(st, shm_detached)) {
+			st = shm_claimed;
+			region_->state.compare_exchange_strong(st, shm_detached);
+		}
+		::munmap(region_, sizeof(shm_region));
+		region_ = nullptr;
+	}
+
+	void shm::reset() {
+		sendbuf_.clear();
+		recvbuf_.clear();
+		queue_.clear();
+		sendpos_ = 0;
+		recvpos_ = 0;
+	}
+
+	bool shm::peer_alive() const {
+		return process_alive(server_ ? region_->client.load() : region_->server.load());
+	}
+
+	shm_ring* shm::rd() const {
+		return &region_->ring[server_ ? 1 : 0];
+	}
+
+	shm_ring* shm::wr() const {
+		return &region_->ring[server_ ? 0 : 1];
+	}
+
+	void shm::update(int ms) {
+		if (!region_ && (name_.empty() || !(server_ ? listen() : attach()))) {
+			if (ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+			return;
+		}
+		uint32_t st = region_->state.load(std::memory_order_acquire);
+		if (server_) {
+			if (st == shm_claimed) {
+				for (auto& r : region_->ring) {
+					r.head.store(0, std::memory_order_relaxed);
+					r.tail.store(0, std::memory_order_relaxed);
+				}
+				reset();
+				connected_ = true;
+				region_->state.store(shm_connected, std::memory_order_release);
+			}
+			else if (st == shm_detached) {
+				if (connected_) {
+					close();
+				}
+				else {
+					detach();
+				}
+				return;
+			}
+		}
+		else if (!connected_) {
+			if (st == shm_connected) {
+				connected_ = true;
+			}
+			else if (st == shm_claimed && peer_alive()) {
+				if (ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				return;
+			}
+			else {
+				detach();
+				return;
+			}
+		}
+		else if (st != shm_connected) {
+			close();
+			return;
+		}
+		if (!connected_) {
+			if (ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+			return;
+		}
+		flush();
+		if (recv() == 0) {
+			if (!peer_alive()) {
+				close();
+				return;
+			}
+			wait(ms);
+			recv();
+		}
+	}
+
+	bool shm::output(const char* buf, size_t len) {
+		if (!connected_) {
+			return false;
+		}
+		uint32_t n = (uint32_t)len;
+		sendbuf_.append((const char*)&n, sizeof(n));
+		sendbuf_.append(buf, len);
+		flush();
+		return true;
+	}
+
+	bool shm::input(std::string& buf) {
+		if (queue_.empty()) {
+			return false;
+		}
+		buf = std::move(queue_.front());
+		queue_.pop_front();
+		return true;
+	}
+
+	// Copy as much of the pending output as the ring has room for. Frames may
+	// be split across several flushes; the reader reassembles them.
+	void shm::flush() {
+		if (sendpos_ == sendbuf_.size()) {
+			return;
+		}
+		shm_ring* w = wr();
+		uint32_t head = w->head.load(std::memory_order_relaxed);
+		uint32_t tail = w->tail.load(std::memory_order_acquire);
+		size_t space = shm_ring_size - (head - tail);
+		size_t n = std::min(space, sendbuf_.size() - sendpos_);
+		if (n == 0) {
+			return;
+		}
+		size_t off = head & (shm_ring_size - 1);
+		size_t first = std::min(n, shm_ring_size - off);
+		memcpy(w->data + off, sendbuf_.data() + sendpos_, first);
+		memcpy(w->data, sendbuf_.data() + sendpos_ + first, n - first);
+		w->head.store(head + (uint32_t)n, std::memory_order_release);
+		w->seq.fetch_add(1);
+		if (w->waiters.load()) {
+			futex_wake(&w->seq);
+		}
+		sendpos_ += n;
+		if (sendpos_ == sendbuf_.size()) {
+			sendbuf_.clear();
+			sendpos_ = 0;
+		}
+		else if (sendpos_ > shm_ring_size) {
+			sendbuf_.erase(0, sendpos_);
+			sendpos_ = 0;
+		}
+	}
+
+	size_t shm::recv() {
+		shm_ring* r = rd();
+		uint32_t tail = r->tail.load(std::memory_order_relaxed);
+		uint32_t head = r->head.load(std::memory_order_acquire);
+		size_t n = head - tail;
+		if (n == 0) {
+			return 0;
+		}
+		size_t off = tail & (shm_ring_size - 1);
+		size_t first = std::min(n, shm_ring_size - off);
+		recvbuf_.append(r->data + off, first);
+		recvbuf_.append(r->data, n - first);
+		r->tail.store(head, std::memory_order_release);
+
+		for (;;) {
+			size_t avail = recvbuf_.size() - recvpos_;
+			uint32_t len;
+			if (avail < sizeof(len)) {
+				break;
+			}
+			memcpy(&len, recvbuf_.data() + recvpos_, sizeof(len));
+			if (avail < sizeof(len) + len) {
+				break;
+			}
+			queue_.emplace_back(recvbuf_, recvpos_ + sizeof(len), len);
+			recvpos_ += sizeof(len) + len;
+		}
+		if (recvpos_ == recvbuf_.size()) {
+			recvbuf_.clear();
+			recvpos_ = 0;
+		}
+		else if (recvpos_ > shm_ring_size) {
+			recvbuf_.erase(0, recvpos_);
+			recvpos_ = 0;
+		}
+		return n;
+	}
+
+	void shm::wait(int ms) {
+		if (ms <= 0) {
+			return;
+		}
+		shm_ring* r = rd();
+		r->waiters.fetch_add(1);
+		uint32_t seq = r->seq.load();
+		if (r->head.load() == r->tail.load(std::memory_order_relaxed)) {
+			futex_wait(&r->seq, seq, ms);
+		}
+		r->waiters.fetch_sub(1);
+	}
+
+	void shm::close() {
+		bool connected = connected_;
+		connected_ = false;
+		reset();
+		if (region_ && (connected || !server_)) {
+			detach();
+		}
+		if (connected && close_event_fn) {
+			auto fn = close_event_fn;
+			close_event_fn = nullptr;
+			fn(close_event_ud);
+		}
+	}
+
+	bool shm::is_closed() const {
+		return !connected_;
+	}
+
+	void shm::on_close_event(CloseEvent fn, void* ud) {
+		close_event_fn = fn;
+		close_event_ud = ud;
+	}
+
+	size_t shm::send_size() {
+		return sendbuf_.size() - sendpos_;
+	}
+}}
+
+#else
+
+namespace vscode { namespace io {
+	shm::shm()
+	{ }
+
+	shm::~shm()
+	{ }
+
+	bool shm::open_server(std::string const& name) {
+		return false;
+	}
+
+	bool shm::open_client(std::string const& name) {
+		return false;
+	}
+
+	void shm::update(int ms) {
+	}
+
+	bool shm::output(const char* buf, size_t len) {
+		return false;
+	}
+
+	bool shm::input(std::string& buf) {
+		return false;
+	}
+
+	void shm::close() {
+	}
+
+	bool shm::is_closed() const {
+		return true;
+	}
+
+	void shm::on_close_event(CloseEvent fn, void* ud) {
+	}
+
+	size_t shm::send_size() {
+		return 0;
+	}
+}}
+#endif
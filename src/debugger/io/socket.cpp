@@ -1,16 +1,23 @@
 #include <debugger/io/socket.h>
 
 #define NETLOG_BACKEND NETLOG_EMPTY_BACKEND	
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <string>	
 #include <thread> 	
+#include <string.h>
 #include <net/poller.h>
 #include <net/tcp/connecter.h>
 #include <net/tcp/listener.h> 
 #include <net/tcp/stream.h>	
 #include <base/util/format.h>
 #include <debugger/io/stream.h>
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
 
 namespace vscode { namespace io {
 	class sock_server;
@@ -19,6 +26,38 @@ namespace vscode { namespace io {
 	typedef std::function<bool()> EventIn;
 	typedef std::function<void()> EventClose;
 
+	// Local sockets are only usable by the user running the debuggee (or root);
+	// anything else could read and drive the debug session.
+	static bool accept_peer(net::socket::fd_t fd, const net::endpoint& ep)
+	{
+#if !defined(_WIN32)
+		if (ep.family() == AF_UNIX) {
+			uid_t uid;
+			if (!net::socket::peer_uid(fd, uid)) {
+				return false;
+			}
+			return uid == geteuid() || uid == 0;
+		}
+#endif
+		return true;
+	}
+
+#if !defined(_WIN32)
+	// Whether something still accepts connections on a local socket file.
+	// Only a refused connection (or a file that is gone) proves it stale.
+	static bool local_in_use(const net::endpoint& ep)
+	{
+		net::socket::fd_t fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd == net::socket::retired_fd) {
+			return true;
+		}
+		net::socket::nonblocking(fd);
+		bool live = ::connect(fd, ep.addr(), (socklen_t)ep.addrlen()) == 0 || (errno != ECONNREFUSED && errno != ENOENT);
+		::close(fd);
+		return live;
+	}
+#endif
+
 	class sock_session
 		: public net::tcp::stream
 	{
@@ -64,8 +103,19 @@ namespace vscode { namespace io {
 		net::endpoint            endpoint_;
 		std::vector<std::unique_ptr<sock_session>> clearlist_;
 		sock_stream&             stream_;
+		std::chrono::steady_clock::time_point next_probe_;
 	};
 
+	bool sock_stream::valid_address(const char* addr)
+	{
+#if !defined(_WIN32)
+		if (strncmp(addr, "unix:", 5) == 0) {
+			return net::endpoint(addr).valid();
+		}
+#endif
+		return true;
+	}
+
 	sock_stream::sock_stream()
 		: s(nullptr)
 	{ }
@@ -81,6 +131,10 @@ namespace vscode { namespace io {
 		if (is_closed()) return false;
 		return len == s->send(buf, len);
 	}
+	size_t sock_stream::send_size() {
+		if (is_closed()) return 0;
+		return s->send_size();
+	}
 	void sock_stream::open(sock_session* s) {
 		this->s = s;
 	}
@@ -116,16 +170,23 @@ namespace vscode { namespace io {
 		, session_()
 		, endpoint_(ep)
 		, stream_(stream)
+		, next_probe_()
 	{
 		net::socket::initialize();
-		base_type::open();
+		base_type::open(endpoint_.family());
 	}
 
 	sock_server::~sock_server()
 	{
+		bool owned = is_listening();
 		base_type::close();
 		if (session_)
 			session_->close();
+#if !defined(_WIN32)
+		if (owned && endpoint_.family() == AF_UNIX && !endpoint_.abstract()) {
+			::unlink(endpoint_.path().c_str());
+		}
+#endif
 	}
 
 	void sock_server::update()
@@ -146,12 +207,37 @@ namespace vscode { namespace io {
 
 	bool sock_server::listen()
 	{
+#if !defined(_WIN32)
+		if (endpoint_.family() == AF_UNIX && !endpoint_.abstract()) {
+			// A socket file left behind by a previous run would make bind fail,
+			// but one that a live server still listens on is not ours to remove.
+			// update() retries listen, so the probe is rate limited.
+			std::string path = endpoint_.path();
+			struct stat st;
+			if (::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+				auto now = std::chrono::steady_clock::now();
+				if (now < next_probe_) {
+					return false;
+				}
+				next_probe_ = now + std::chrono::seconds(2);
+				if (local_in_use(endpoint_)) {
+					return false;
+				}
+				::unlink(path.c_str());
+			}
+			if (!base_type::listen(endpoint_)) {
+				return false;
+			}
+			::chmod(path.c_str(), S_IRUSR | S_IWUSR);
+			return true;
+		}
+#endif
 		return base_type::listen(endpoint_);
 	}
 
 	void sock_server::event_accept(net::socket::fd_t fd, const net::endpoint& ep)
 	{
-		if (session_)
+		if (session_ || !accept_peer(fd, ep))
 		{
 			net::socket::close(fd);
 			return;
@@ -178,7 +264,7 @@ namespace vscode { namespace io {
 
 	uint16_t sock_server::get_port() const
 	{
-		if (sock == net::socket::retired_fd) {
+		if (sock == net::socket::retired_fd || endpoint_.family() != AF_INET) {
 			return 0;
 		}
 		sockaddr_in addr;
@@ -254,12 +340,14 @@ namespace vscode { namespace io {
 		bool stream_update();
 
 	private:
+		std::unique_ptr<sock_session> session_;
 		net::endpoint endpoint_;
 		sock_stream&  stream_;
 	};
 
 	sock_client::sock_client(net::poller_t* poll, sock_stream& stream, const net::endpoint& ep)
 		: base_type(poll)
+		, session_()
 		, endpoint_(ep)
 		, stream_(stream)
 	{
@@ -269,7 +357,15 @@ namespace vscode { namespace io {
 
 	void sock_client::event_connect(net::socket::fd_t fd, const net::endpoint& ep)
 	{
-		stream_.open(new sock_session([this]() { }, std::bind(&sock_client::stream_update, this), get_poller()));
+		if (!accept_peer(fd, ep))
+		{
+			net::socket::close(fd);
+			reconnect();
+			return;
+		}
+		session_.reset(new sock_session([this]() { }, std::bind(&sock_client::stream_update, this), get_poller()));
+		session_->attach(fd, ep);
+		stream_.open(session_.get());
 	}
 
 	bool sock_client::stream_update()
@@ -2,55 +2,130 @@
 #include <base/util/format.h>
 
 namespace vscode { namespace io {
+	enum {
+		max_header = 1024,
+	};
+
 	stream::stream()
 	: stat(0)
 	, buf()
 	, len(0)
+	, compressed(false)
+	, accept_encoding(false)
+	, peer_accept(false)
+	, compress_threshold(4096)
 	{ }
 	
 	void stream::update(int ms) {
-		for (size_t n = raw_peek(); n; --n)
-		{
-			char c = 0;
-			raw_recv(&c, 1);
-			buf.push_back(c);
-			switch (stat)
-			{
-			case 0:
-				if (c == '\r') stat = 1;
-				break;
-			case 1:
-				stat = 0;
-				if (c == '\n') {
-					if (buf.substr(0, 16) != "Content-Length: ") {
-						close();
+		size_t n = raw_peek();
+		if (n) {
+			size_t old = buf.size();
+			buf.resize(old + n);
+			if (!raw_recv(&buf[old], n)) {
+				buf.resize(old);
+				return;
+			}
+		}
+		size_t pos = 0;
+		for (;;) {
+			if (stat == 0) {
+				size_t end = buf.find("\r\n\r\n", pos);
+				if (end == std::string::npos) {
+					if (buf.size() - pos > max_header) {
+						fail();
 						return;
 					}
+					break;
+				}
+				if (!parse_header(pos, end)) {
+					fail();
+					return;
+				}
+				pos = end + 4;
+				stat = 2;
+			}
+			if (buf.size() - pos < len) {
+				break;
+			}
+			if (!enqueue(buf.data() + pos, len)) {
+				fail();
+				return;
+			}
+			pos += len;
+			stat = 0;
+		}
+		buf.erase(0, pos);
+	}
+
+	void stream::fail() {
+		stat = 0;
+		buf.clear();
+		close();
+	}
+
+	bool stream::parse_header(size_t pos, size_t end) {
+		bool has_length = false;
+		compressed = false;
+		while (pos < end) {
+			size_t eol = buf.find("\r\n", pos);
+			if (eol == std::string::npos || eol > end) {
+				eol = end;
+			}
+			size_t colon = buf.find(": ", pos);
+			if (colon != std::string::npos && colon < eol) {
+				std::string key = buf.substr(pos, colon - pos);
+				std::string value = buf.substr(colon + 2, eol - colon - 2);
+				if (key == "Content-Length") {
 					try {
-						len = (size_t)std::stol(buf.substr(16, buf.size() - 18));
-						stat = 2;
+						len = (size_t)std::stoul(value);
+						has_length = true;
 					}
 					catch (...) {
-						close();
-						return;
+						return false;
 					}
-					buf.clear();
 				}
-				break;
-			case 2:
-				if (buf.size() >= (len + 2))
-				{
-					queue.enqueue(buf.substr(2, len));
-					buf.clear();
-					stat = 0;
+				else if (key == "Content-Encoding") {
+					if (value != "lz4") {
+						return false;
+					}
+					compressed = true;
+				}
+				else if (key == "Accept-Encoding") {
+					peer_accept = value.find("lz4") != std::string::npos;
 				}
-				break;
 			}
+			pos = eol + 2;
+		}
+		return has_length;
+	}
+
+	bool stream::enqueue(const char* data, size_t n) {
+		if (!compressed) {
+			queue.enqueue(std::string(data, n));
+			return true;
+		}
+		std::string raw;
+		if (!lz4::decompress(data, n, raw)) {
+			return false;
 		}
+		queue.enqueue(std::move(raw));
+		return true;
 	}
 
 	bool stream::output(const char* buf, size_t len) {
-		auto l = ::base::format("Content-Length: %d\r\n\r\n", len);
+		const char* accept = accept_encoding ? "Accept-Encoding: lz4\r\n" : "";
+		if (peer_accept && len >= compress_threshold) {
+			if (!lz4ctx) {
+				lz4ctx.reset(new lz4::context);
+			}
+			zbuf.clear();
+			lz4::compress(*lz4ctx, buf, len, zbuf);
+			if (zbuf.size() < len) {
+				auto l = ::base::format("Content-Length: %d\r\nContent-Encoding: lz4\r\n%s\r\n", zbuf.size(), accept);
+				return raw_send(l.data(), l.size()) && raw_send(zbuf.data(), zbuf.size());
+			}
+		}
+		auto l = ::base::format("Content-Length: %d\r\n%s\r\n", len, accept);
 		if (!raw_send(l.data(), l.size())) {
 			return false;
 		}
@@ -68,6 +143,8 @@ namespace vscode { namespace io {
 		stat = 0;
 		buf.clear();
 		len = 0;
+		compressed = false;
+		peer_accept = false;
 		std::string buf;
 		for (; queue.try_dequeue(buf); ) {
 		}
@@ -1,5 +1,6 @@
 #include <debugger/luathread.h>
 #include <debugger/impl.h>
+#include <new>
 
 namespace vscode
 {
@@ -29,10 +30,70 @@ namespace vscode
 		return pos;
 	}
 
-	static void debugger_hook(luathread* thread, lua_State *L, lua::Debug *ar)
+	// Functions a thread remembers as having no breakpoint; like the
+	// breakpointMgr cache it starts over when full.
+	static const size_t clean_function_limit = 4096;
+
+	static intptr_t function_key(debug& debug)
+	{
+		if (debug.is_virtual()) {
+			return 0;
+		}
+		lua_State* L = debug.L();
+		if (!lua_getinfo(L, "f", (lua_Debug*)debug.value())) {
+			return 0;
+		}
+		intptr_t f = (intptr_t)lua_getprotohash(L, -1);
+		lua_pop(L, 1);
+		return f;
+	}
+
+	static int HOOK_ANCHOR = 0;
+
+	static int anchor_gc(lua_State* L)
+	{
+		((hook_anchor*)lua_touserdata(L, 1))->~hook_anchor();
+		return 0;
+	}
+
+	static hook_anchor* get_anchor(lua_State* L)
+	{
+		if (LUA_TUSERDATA == lua_rawgetp(L, LUA_REGISTRYINDEX, &HOOK_ANCHOR)) {
+			hook_anchor* anchor = (hook_anchor*)lua_touserdata(L, -1);
+			lua_pop(L, 1);
+			return anchor;
+		}
+		lua_pop(L, 1);
+		hook_anchor* anchor = new (lua_newuserdata(L, sizeof(hook_anchor))) hook_anchor;
+		lua_newtable(L);
+		lua_pushcfunction(L, anchor_gc);
+		lua_setfield(L, -2, "__gc");
+		lua_setmetatable(L, -2);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, &HOOK_ANCHOR);
+		return anchor;
+	}
+
+	luathread* luathread::get(lua_State* L)
+	{
+		if (LUA_TUSERDATA != lua_rawgetp(L, LUA_REGISTRYINDEX, &HOOK_ANCHOR)) {
+			lua_pop(L, 1);
+			return nullptr;
+		}
+		hook_anchor* anchor = (hook_anchor*)lua_touserdata(L, -1);
+		lua_pop(L, 1);
+		return anchor->thread;
+	}
+
+	static void debugger_hook(hook_anchor* anchor, lua_State *L, lua::Debug *ar)
 	{
+		luathread* thread = anchor->thread;
+		if (!thread) {
+			lua_sethook(L, 0, 0, 0);
+			return;
+		}
 		if (!thread->enable) return;
-		thread->dbg.hook(thread, debug(L, ar));
+		debug d(L, ar);
+		thread->dbg.hook(thread, d);
 	}
 
 	static void debugger_panic(luathread* thread, lua_State *L)
@@ -41,6 +102,40 @@ namespace vscode
 		thread->dbg.panic(thread, L);
 	}
 
+#if defined(DEBUGGER_EXTRASPACE_HOOK)
+#if defined(DEBUGGER_BRIDGE)
+#	error "DEBUGGER_EXTRASPACE_HOOK needs the debugger built with its own Lua"
+#endif
+	// The VM is ours, so the hook_anchor is kept in LUA_EXTRASPACE of the
+	// main thread, which coroutines copy when created, and no trampoline
+	// is needed.
+	static hook_anchor*& extraspace_anchor(lua_State* L)
+	{
+		return *(hook_anchor**)lua_getextraspace(L);
+	}
+
+	static void extraspace_hook(lua_State* L, lua_Debug* ar)
+	{
+		hook_anchor* anchor = extraspace_anchor(L);
+		if (!anchor) {
+			lua_sethook(L, 0, 0, 0);
+			return;
+		}
+		debugger_hook(anchor, L, (lua::Debug*)ar);
+	}
+
+	static int extraspace_panic(lua_State* L)
+	{
+		hook_anchor* anchor = extraspace_anchor(L);
+		luathread* thread = anchor ? anchor->thread : nullptr;
+		if (!thread) {
+			return 0;
+		}
+		debugger_panic(thread, L);
+		return thread->oldpanic ? thread->oldpanic(L) : 0;
+	}
+#endif
+
 	luathread::luathread(int id, debugger_impl& dbg, lua_State* L)
 		: id(id)
 		, enable(true)
@@ -48,6 +143,7 @@ namespace vscode
 		, busy(false)
 		, dbg(dbg)
 		, L(L)
+		, anchor(get_anchor(L))
 		, oldpanic(lua_atpanic(L, 0))
 		, step_(step::in)
 		, stepping_target_level_(0)
@@ -56,16 +152,27 @@ namespace vscode
 		, cur_function(0)
 		, has_function(false)
 		, has_breakpoint(false)
+		, clean_functions()
+		, epoch(0)
+		, has_exception(false)
 		, ob_(id)
 	{
+		anchor->thread = this;
+#if defined(DEBUGGER_EXTRASPACE_HOOK)
+		extraspace_anchor(L) = anchor;
+		install_hook(LUA_MASKCALL | LUA_MASKRET | LUA_MASKLINE | LUA_MASKEXCEPTION);
+		lua_atpanic(L, extraspace_panic);
+#else
 		thunk_bind(
 			reinterpret_cast<intptr_t>(L),
-			reinterpret_cast<intptr_t>(this)
+			reinterpret_cast<intptr_t>(anchor)
 		);
-		thunk_hook.reset(thunk_create_hook(
-			reinterpret_cast<intptr_t>(this),
-			reinterpret_cast<intptr_t>(&debugger_hook)
-		));
+		if (!anchor->hook) {
+			anchor->hook.reset(thunk_create_hook(
+				reinterpret_cast<intptr_t>(anchor),
+				reinterpret_cast<intptr_t>(&debugger_hook)
+			));
+		}
 		thunk_panic.reset(thunk_create_panic(
 			reinterpret_cast<intptr_t>(this),
 			reinterpret_cast<intptr_t>(&debugger_panic),
@@ -73,6 +180,7 @@ namespace vscode
 		));
 		install_hook(LUA_MASKCALL | LUA_MASKRET | LUA_MASKLINE | LUA_MASKEXCEPTION);
 		lua_atpanic(L, (lua_CFunction)thunk_panic->data);
+#endif
 	}
 
 	luathread::~luathread()
@@ -81,11 +189,16 @@ namespace vscode
 		if (release) return;
 		lua_sethook(L, 0, 0, 0);
 		lua_atpanic(L, oldpanic);
+		anchor->thread = nullptr;
 	}
 
 	void luathread::install_hook(int mask)
 	{
-		lua_sethook(L, (lua_Hook)thunk_hook->data, mask, 0);
+#if defined(DEBUGGER_EXTRASPACE_HOOK)
+		lua_sethook(L, extraspace_hook, mask, 0);
+#else
+		lua_sethook(L, (lua_Hook)anchor->hook->data, mask, 0);
+#endif
 	}
 
 	void luathread::release_thread()
@@ -171,21 +284,59 @@ namespace vscode
 		if (!has_function) {
 			has_function = true;
 			has_breakpoint = false;
-			cur_function = breakpointmgr.get_function(debug);
+			intptr_t f = function_key(debug);
+			cur_function = breakpointmgr.get_function(debug, f);
 			if (cur_function) {
 				has_breakpoint = cur_function->has_breakpoint();
 			}
+			if (f && !has_breakpoint) {
+				if (clean_functions.size() >= clean_function_limit) {
+					clean_functions.clear();
+				}
+				clean_functions[f] = cur_function;
+			}
 		}
 	}
 
-	void luathread::update_breakpoint()
+	// Called without the debugger lock while running: handles the event and
+	// returns true if it cannot stop, otherwise leaves it to the locked path.
+	bool luathread::hook_running(debug& debug)
 	{
-		if (cur_function) {
-			has_function = false;
-			has_breakpoint = false;
+		switch (debug.event()) {
+		case LUA_HOOKCALL:
+		case LUA_HOOKTAILCALL:
+		case LUA_HOOKRET:
+			hook_callret(debug);
+			return true;
+		case LUA_HOOKLINE:
+			if (!has_function) {
+				intptr_t f = function_key(debug);
+				auto it = f ? clean_functions.find(f) : clean_functions.end();
+				if (it == clean_functions.end()) {
+					return false;
+				}
+				has_function = true;
+				has_breakpoint = false;
+				cur_function = it->second;
+			}
+			return !has_breakpoint;
+		case LUA_HOOKEXCEPTION:
+			return !has_exception;
+		default:
+			return true;
 		}
 	}
 
+	void luathread::update_epoch(uint32_t e, bool exception)
+	{
+		epoch = e;
+		has_exception = exception;
+		has_function = false;
+		has_breakpoint = false;
+		cur_function = nullptr;
+		clean_functions.clear();
+	}
+
 	void luathread::reset_session(lua_State* L)
 	{
 		ob_.reset(L);
@@ -620,18 +620,16 @@ namespace vscode {
 				lua::Debug entry;
 				lua_pushvalue(L, idx);
 				if (lua_getinfo(L, ">S", (lua_Debug*)&entry)) {
-					source* s = dbg.createSource(&entry);
+					source* s = dbg.createSource(&entry, L, idx);
 					if (s && s->valid) {
 						if (s->ref) {
-							std::string code;
-							if (dbg.getCode(s->ref, code)) {
-								std::string_view pos = getFunctionCode(code.c_str(), entry.linedefined, entry.lastlinedefined);
-								if (!pos.empty()) {
-									return std::string(pos);
-								}
-								return base::format("%s:%d", code.c_str(), entry.linedefined);
+							// The chunk text is the function's own source.
+							const char* code = entry.source;
+							std::string_view pos = getFunctionCode(code, entry.linedefined, entry.lastlinedefined);
+							if (!pos.empty()) {
+								return std::string(pos);
 							}
-							return base::format("Unk function: %08x", s->ref);
+							return base::format("%s:%d", code, entry.linedefined);
 						}
 						else {
 							return base::format("%s:%d", dbg.path_clientrelative(s->path), entry.linedefined);
@@ -739,9 +737,10 @@ namespace vscode {
 		}
 	};
 
-	frame::frame(int threadId, int frameId)
+	frame::frame(int threadId, int frameId, size_t limit)
 		: threadId(threadId)
 		, frameId(frameId)
+		, limit(limit)
 	{ }
 
 	void frame::new_scope(debug& debug, lua::Debug* ar, wprotocol& res)
@@ -798,9 +797,13 @@ namespace vscode {
 		values.clear();
 	}
 
+	// A reference of 0 tells the client the value cannot be expanded.
 	int64_t frame::new_variable(size_t parent, value::Type type, int index)
 	{
 		size_t n = values.size();
+		if (n >= limit) {
+			return 0;
+		}
 		value v = {
 			n,
 			parent,
@@ -1314,25 +1317,36 @@ finish:
 	observer::observer(int threadId)
 		: threadId(threadId)
 		, frames()
+		, watches(0)
 	{ }
 
 	void observer::reset(lua_State* L)
 	{
 		if (L) watch_table_clear(L);
 		frames.clear();
+		watches = 0;
 	}
 
-	frame* observer::create_or_get_frame(int frameId)
+	frame* observer::create_or_get_frame(debugger_impl& dbg, int frameId)
 	{
 		auto it = frames.find(frameId);
 		if (it != frames.end()) {
 			return &(it->second);
 		}
-		auto res = frames.insert(std::make_pair(frameId, frame(threadId, frameId)));
+		auto res = frames.insert(std::make_pair(frameId, frame(threadId, frameId, dbg.variable_limit())));
 		return &(res.first->second);
 	}
 
-	int64_t observer::new_watch(lua_State* L, int idx, frame* frame, const std::string& expression)
+	void observer::usage(memory_usage& variables, memory_usage& watch) const
+	{
+		for (auto& f : frames) {
+			variables.entries += f.second.values.size();
+			variables.bytes += sizeof(f) + f.second.values.capacity() * sizeof(value);
+		}
+		watch.entries += watches;
+	}
+
+	int64_t observer::new_watch(lua_State* L, int idx, frame* frame, const std::string& expression, size_t limit)
 	{
 		watch_table(L);
 		lua_pushlstring(L, expression.data(), expression.size());
@@ -1344,6 +1358,11 @@ finish:
 			return frame->new_variable(-1, value::Type::watch, n);
 		}
 		lua_pop(L, 1);
+		if (limit && watches >= limit) {
+			lua_pop(L, 1);
+			return 0;
+		}
+		watches++;
 		int n = (int)(1 + luaL_len(L, -1));
 		lua_pushvalue(L, idx);
 		lua_rawseti(L, -2, n);
@@ -1406,7 +1425,7 @@ finish:
 			}
 			int resIdx = lua_absindex(L, -nresult);
 			if (var::canExtand(L, resIdx)) {
-				int64_t reference = new_watch(L, resIdx, create_or_get_frame(frameId), expression);
+				int64_t reference = new_watch(L, resIdx, create_or_get_frame(dbg, frameId), expression, dbg.watch_limit());
 				res("variablesReference").Int64(reference);
 			}
 			lua_pop(L, nresult);
@@ -1437,7 +1456,7 @@ finish:
 			dbg.response_error(req, "Error retrieving stack frame");
 			return;
 		}
-		frame* frame = create_or_get_frame(frameId);
+		frame* frame = create_or_get_frame(dbg, frameId);
 		dbg.response_success(req, [&](wprotocol& res)
 		{
 			frame->new_scope(debug, &entry, res);
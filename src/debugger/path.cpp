@@ -1,11 +1,13 @@
 #include <debugger/path.h>
 #include <base/util/unicode.h>
 #include <base/util/string_view.h>
-#include <deque>
+#include <algorithm>
+#include <mutex>
 #if defined(_WIN32)
 #include <Windows.h>
 #else
 #include <unistd.h>
+#include <errno.h>
 #include <memory>
 #endif
 
@@ -15,20 +17,7 @@ namespace vscode { namespace path {
 		return c == '/' || c == '\\';
 	}
 
-	static void path_push(std::deque<std::string>& stack, const std::string& path)
-	{
-		if (path.empty()) {
-			// do nothing
-		}
-		else if (path == ".." && !stack.empty() && stack.back() != "..") {
-			stack.pop_back();
-		}
-		else if (path != ".") {
-			stack.push_back(path);
-		}
-	}
-
-	static std::string path_currentpath()
+	static std::string path_getcwd()
 	{
 #if defined(_WIN32)
 		DWORD len = GetCurrentDirectoryW(0, nullptr);
@@ -52,45 +41,89 @@ namespace vscode { namespace path {
 				return buf.get();
 			}
 		}
-		return std::string("~/");
+		return std::string("/");
 #endif
 	}
 
-	static std::string path_normalize(const std::string& path, std::deque<std::string>& stack)
+	// The working directory is asked for once and remembered until
+	// reset_currentpath, so relative chunk names cost no system call.
+	static std::mutex  cwd_mtx;
+	static std::string cwd;
+
+	static std::string path_currentpath()
+	{
+		std::lock_guard<std::mutex> lock(cwd_mtx);
+		if (cwd.empty()) {
+			cwd = path_getcwd();
+		}
+		return cwd;
+	}
+
+	// Components are kept in `out` as `sep name` after the root, which ends
+	// at `root`. Removes the last one unless there is none or it is "..".
+	static bool path_pop(std::string& out, size_t root, char sep)
+	{
+		if (out.size() <= root) {
+			return false;
+		}
+		size_t pos = out.size();
+		while (out[pos - 1] != sep) {
+			--pos;
+		}
+		if (out.size() - pos == 2 && out[pos] == '.' && out[pos + 1] == '.') {
+			return false;
+		}
+		out.resize(pos - 1);
+		return true;
+	}
+
+	static void path_push(std::string& out, size_t root, const char* name, size_t len, char sep)
+	{
+		if (len == 0) {
+			return;
+		}
+		if (len == 1 && name[0] == '.') {
+			return;
+		}
+		if (len == 2 && name[0] == '.' && name[1] == '.' && path_pop(out, root, sep)) {
+			return;
+		}
+		out += sep;
+		out.append(name, len);
+	}
+
+	// Appends the normalized form of `path` to `out` in one pass and returns
+	// the end of its root.
+	static size_t path_normalize(std::string& out, const std::string& path, char sep)
 	{
-		std::string root;
+		size_t root;
 		size_t pos = path.find(':', 0);
-		if (pos == path.npos) {
-			root = path_normalize(path_currentpath(), stack);
+		if (pos != path.npos) {
+			pos++;
+			out.append(path, 0, pos);
+			root = out.size();
+		}
+#if !defined(_WIN32)
+		else if (!path.empty() && path[0] == '/') {
 			pos = 0;
+			root = out.size();
 		}
+#endif
 		else {
-			pos++;
-			root = path.substr(0, pos);
+			root = path_normalize(out, path_currentpath(), sep);
+			pos = 0;
 		}
 
 		for (size_t i = pos; i < path.size(); ++i) {
-			char c = path[i];
-			if (is_sep(c)) {
-				if (i > pos) {
-					path_push(stack, path.substr(pos, i - pos));
-				}
+			if (is_sep(path[i])) {
+				path_push(out, root, path.data() + pos, i - pos, sep);
 				pos = i + 1;
 			}
 		}
-		path_push(stack, path.substr(pos));
+		path_push(out, root, path.data() + pos, path.size() - pos, sep);
 		return root;
 	}
 
-	static std::string path_create(const std::string& path, const std::deque<std::string>& stack, char sep)
-	{
-		std::string result = path;
-		for (auto& e : stack) {
-			result += sep + e;
-		}
-		return result;
-	}
-
 	template <typename EQUAL>
 	bool glob_match(const std::string_view& pattern, const std::string_view& target, EQUAL equal)
 	{
@@ -129,9 +162,16 @@ namespace vscode { namespace path {
 
 	std::string normalize(const std::string& path, char sep)
 	{
-		std::deque<std::string> stack;
-		std::string result = path_normalize(path, stack);
-		return path_create(result, stack, sep);
+		std::string result;
+		result.reserve(path.size());
+		path_normalize(result, path, sep);
+		return result;
+	}
+
+	void reset_currentpath()
+	{
+		std::lock_guard<std::mutex> lock(cwd_mtx);
+		cwd.clear();
 	}
 
 	std::string filename(const std::string& path)
@@ -152,26 +192,194 @@ namespace vscode { namespace path {
 
 	std::string relative(const std::string& path, const std::string& base, char sep)
 	{
-		std::deque<std::string> spath, sbase;
-		std::string rpath = path_normalize(path, spath);
-		std::string rbase = path_normalize(base, sbase);
-		if (rpath != rbase) {
-			return path_create(rpath, spath, sep);
-		}
-		while (!spath.empty() && !sbase.empty() && spath.front() == sbase.front()) {
-			spath.pop_front();
-			sbase.pop_front();
+		std::string spath, sbase;
+		size_t i = path_normalize(spath, path, sep);
+		size_t j = path_normalize(sbase, base, sep);
+		if (spath.compare(0, i, sbase, 0, j) != 0) {
+			return spath;
 		}
-		if (spath.empty() && sbase.empty()) {
-			return "." + sep;
+		while (i < spath.size() && j < sbase.size()) {
+			size_t ie = std::min(spath.find(sep, i + 1), spath.size());
+			size_t je = std::min(sbase.find(sep, j + 1), sbase.size());
+			if (spath.compare(i, ie - i, sbase, j, je - j) != 0) {
+				break;
+			}
+			i = ie;
+			j = je;
 		}
-		std::string result = "";
-		for (auto& e : sbase) {
-			result += sep + "..";
+		if (i == spath.size() && j == sbase.size()) {
+			return std::string(".") + sep;
 		}
-		for (auto& e : spath) {
-			result += sep + e;
+		std::string result;
+		for (; j < sbase.size(); j = std::min(sbase.find(sep, j + 1), sbase.size())) {
+			result += sep;
+			result += "..";
 		}
+		result.append(spath, i, spath.npos);
 		return result.substr(1);
 	}
+
+	void glob_set::clear()
+	{
+		nfa_.clear();
+		starts_.clear();
+		compiled_ = false;
+	}
+
+	void glob_set::add(const std::string& pattern)
+	{
+		size_t start = nfa_.size();
+		starts_.push_back((uint32_t)start);
+		for (char c : pattern) {
+			if (c == '*') {
+				if (nfa_.size() == start || nfa_.back() != star) {
+					nfa_.push_back(star);
+				}
+			}
+			else if (c == '?') {
+				nfa_.push_back(any);
+			}
+			else {
+				nfa_.push_back(tochar(c));
+			}
+		}
+		nfa_.push_back(accept);
+		compiled_ = false;
+	}
+
+	// One bit per pattern position. advance_[k] holds the positions that
+	// consume a character of class k and move on; star positions consume
+	// anything and stay. Class 0 is every character no pattern names.
+	void glob_set::compile()
+	{
+		words_ = (nfa_.size() + 63) / 64;
+		class_.fill(0);
+		size_t classes = 1;
+		for (int k : nfa_) {
+			if (k >= 0 && class_[k] == 0) {
+				class_[k] = (uint8_t)classes++;
+			}
+		}
+		advance_.assign(classes, bits(words_, 0));
+		star_.assign(words_, 0);
+		accept_.assign(words_, 0);
+		start_.assign(words_, 0);
+		for (size_t i = 0; i < nfa_.size(); ++i) {
+			uint64_t bit = (uint64_t)1 << (i % 64);
+			int k = nfa_[i];
+			if (k == star) {
+				star_[i / 64] |= bit;
+			}
+			else if (k == accept) {
+				accept_[i / 64] |= bit;
+			}
+			else if (k == any) {
+				for (auto& a : advance_) {
+					a[i / 64] |= bit;
+				}
+			}
+			else {
+				advance_[class_[k]][i / 64] |= bit;
+			}
+		}
+		for (uint32_t i : starts_) {
+			start_[i / 64] |= (uint64_t)1 << (i % 64);
+			if (nfa_[i] == star) {
+				start_[(i + 1) / 64] |= (uint64_t)1 << ((i + 1) % 64);
+			}
+		}
+		cur_.resize(words_);
+		next_.resize(words_);
+		compiled_ = true;
+	}
+
+	bool glob_set::match(const std::string& target)
+	{
+		if (nfa_.empty()) {
+			return false;
+		}
+		if (!compiled_) {
+			compile();
+		}
+		cur_ = start_;
+		for (char c : target) {
+			const bits& adv = advance_[class_[(unsigned char)tochar(c)]];
+			uint64_t carry = 0;
+			uint64_t alive = 0;
+			for (size_t w = 0; w < words_; ++w) {
+				uint64_t t = cur_[w] & adv[w];
+				next_[w] = (t << 1) | carry | (cur_[w] & star_[w]);
+				carry = t >> 63;
+			}
+			// A star may also match nothing: its successor is live with it.
+			carry = 0;
+			for (size_t w = 0; w < words_; ++w) {
+				uint64_t s = next_[w] & star_[w];
+				next_[w] |= (s << 1) | carry;
+				carry = s >> 63;
+				alive |= next_[w];
+			}
+			if (!alive) {
+				return false;
+			}
+			cur_.swap(next_);
+		}
+		for (size_t w = 0; w < words_; ++w) {
+			if (cur_[w] & accept_[w]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	prefix_map::prefix_map()
+		: nodes_(1)
+	{ }
+
+	void prefix_map::clear()
+	{
+		nodes_.clear();
+		nodes_.resize(1);
+		entries_.clear();
+	}
+
+	void prefix_map::add(const std::string& prefix, const std::string& replace)
+	{
+		uint32_t n = 0;
+		for (char c : prefix) {
+			auto it = nodes_[n].child.find(tochar(c));
+			if (it != nodes_[n].child.end()) {
+				n = it->second;
+				continue;
+			}
+			uint32_t next = (uint32_t)nodes_.size();
+			nodes_[n].child.insert(std::make_pair(tochar(c), next));
+			nodes_.emplace_back();
+			n = next;
+		}
+		if (nodes_[n].entry == npos) {
+			nodes_[n].entry = entries_.size();
+			entries_.push_back(std::make_pair(prefix.size(), replace));
+		}
+	}
+
+	bool prefix_map::apply(const std::string& target, std::string& result) const
+	{
+		size_t best = nodes_[0].entry;
+		uint32_t n = 0;
+		for (char c : target) {
+			auto it = nodes_[n].child.find(tochar(c));
+			if (it == nodes_[n].child.end()) {
+				break;
+			}
+			n = it->second;
+			best = std::min(best, nodes_[n].entry);
+		}
+		if (best == npos) {
+			return false;
+		}
+		auto& e = entries_[best];
+		result = e.second + target.substr(e.first);
+		return true;
+	}
 }}
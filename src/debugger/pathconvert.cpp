@@ -2,30 +2,16 @@
 #include <debugger/path.h>
 #include <base/util/unicode.h>
 #include <base/util/dynarray.h>
-#include <deque>
 #include <regex>
 
 namespace vscode
 {
-	static bool match_sourcemap(const std::string& srv, std::string& cli, const std::string& srvmatch, const std::string& climatch)
-	{
-		size_t i = 0;
-		for (; i < srvmatch.size(); ++i) {
-			if (i >= srv.size()) {
-				return false;
-			}
-			if (path::tochar(srvmatch[i]) == path::tochar(srv[i])) {
-				continue;
-			}
-			return false;
-		}
-		cli = climatch + srv.substr(i);
-		return true;
-	}
-
 	void debugger_impl::initialize_pathconvert(config& config)
 	{
 		sourceMap_.clear();
+		skipFiles_.clear();
+		source2client_.clear();
+		path::reset_currentpath();
 		auto& sourceMaps = config.get("sourceMaps", rapidjson::kArrayType);
 		for (auto& e : sourceMaps.GetArray())
 		{
@@ -38,7 +24,7 @@ namespace vscode
 			{
 				continue;
 			}
-			sourceMap_.push_back(std::make_pair(eary[0].Get<std::string>(), eary[1].Get<std::string>()));
+			sourceMap_.add(eary[0].Get<std::string>(), eary[1].Get<std::string>());
 		}
 		auto& skipFiles = config.get("skipFiles", rapidjson::kArrayType);
 		for (auto& e : skipFiles.GetArray())
@@ -47,27 +33,20 @@ namespace vscode
 			{
 				continue;
 			}
-			skipFiles_.push_back(e.Get<std::string>());
+			skipFiles_.add(e.Get<std::string>());
 		}
 		workspaceFolder_ = config.get("workspaceFolder", rapidjson::kStringType).Get<std::string>();
 	}
 
 	bool debugger_impl::path_server2client(const std::string& server, std::string& client)
 	{
-		for (auto& it : skipFiles_)
+		if (skipFiles_.match(server))
 		{
-			if (path::glob_match(it, server))
-			{
-				return false;
-			}
+			return false;
 		}
-
-		for (auto& it : sourceMap_)
+		if (sourceMap_.apply(server, client))
 		{
-			if (match_sourcemap(server, client, it.first, it.second))
-			{
-				return true;
-			}
+			return true;
 		}
 		client = path::normalize(server, '/');
 		return true;
@@ -96,13 +75,15 @@ namespace vscode
 
 	bool debugger_impl::path_convert(const std::string& source, std::string& client)
 	{
-		auto it = source2client_.find(source);
-		if (it != source2client_.end()) {
-			client = it->second;
+		std::string* cached = source2client_.get(source);
+		if (cached) {
+			DEBUGGER_STATS_ADD(stats_, path_convert_hit, 1);
+			client = *cached;
 			return !client.empty();
 		}
+		DEBUGGER_STATS_ADD(stats_, path_convert_miss, 1);
 		bool ok = path_source2client(source, client);
-		source2client_[source] = client;
+		source2client_.put(source, client, source.size() + client.size());
 		return ok;
 	}
 
@@ -0,0 +1,261 @@
+#include <debugger/io/recorder.h>
+#include <debugger/io/socket.h>
+#include <debugger/cbor.h>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+// Replays the client side of a session recorded with dbg:record() against
+// a debuggee listening on <address>, and reports latency percentiles per
+// command for both the recording and the replay. Each recorded request is
+// sent once the previous one has been answered and as many stopped events
+// have arrived as had been seen before it in the recording, so ids such as
+// threadId, frameId and variablesReference line up with the original run.
+
+using vscode::io::record_entry;
+
+struct message {
+	uint64_t            time;
+	bool                in;
+	rapidjson::Document doc;
+};
+
+static bool parse(const std::string& data, rapidjson::Document& doc)
+{
+	if (vscode::cbor::is_cbor(data.data(), data.size())) {
+		return vscode::cbor::parse(data.data(), data.size(), doc);
+	}
+	return !doc.Parse(data.data(), data.size()).HasParseError() && doc.IsObject();
+}
+
+static bool is_resume(const rapidjson::Value& command)
+{
+	static const char* commands[] = { "continue", "next", "stepIn", "stepOut", "pause", "configurationDone" };
+	for (const char* c : commands) {
+		if (command == c) {
+			return true;
+		}
+	}
+	return false;
+}
+
+typedef std::map<std::string, std::vector<uint64_t>> latencies_t;
+
+// Request -> response latency per command, plus resume -> stopped latency
+// under the "stopped" key.
+static latencies_t analyze(const std::vector<message>& timeline)
+{
+	latencies_t res;
+	std::map<int64_t, std::pair<std::string, uint64_t>> sent;
+	uint64_t resume = 0;
+	bool resumed = false;
+	for (auto& m : timeline) {
+		auto& d = m.doc;
+		if (!d.HasMember("type")) {
+			continue;
+		}
+		if (m.in) {
+			if (d["type"] == "request" && d.HasMember("seq") && d.HasMember("command")) {
+				sent[d["seq"].GetInt64()] = std::make_pair(std::string(d["command"].GetString()), m.time);
+				if (is_resume(d["command"])) {
+					resume = m.time;
+					resumed = true;
+				}
+			}
+		}
+		else if (d["type"] == "response" && d.HasMember("request_seq")) {
+			auto it = sent.find(d["request_seq"].GetInt64());
+			if (it != sent.end()) {
+				res[it->second.first].push_back(m.time - it->second.second);
+				sent.erase(it);
+			}
+		}
+		else if (d["type"] == "event" && d.HasMember("event") && d["event"] == "stopped") {
+			if (resumed) {
+				res["stopped"].push_back(m.time - resume);
+				resumed = false;
+			}
+		}
+	}
+	return res;
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double q)
+{
+	size_t rank = (size_t)ceil(q * sorted.size());
+	return sorted[rank ? rank - 1 : 0];
+}
+
+static void report(rapidjson::PrettyWriter<rapidjson::StringBuffer>& w, latencies_t& l)
+{
+	w.StartObject();
+	for (auto& p : l) {
+		auto& v = p.second;
+		std::sort(v.begin(), v.end());
+		w.Key(p.first.c_str());
+		w.StartObject();
+		w.Key("count");
+		w.Uint64(v.size());
+		w.Key("p50_us");
+		w.Uint64(percentile(v, 0.5));
+		w.Key("p99_us");
+		w.Uint64(percentile(v, 0.99));
+		w.Key("max_us");
+		w.Uint64(v.back());
+		w.EndObject();
+	}
+	w.EndObject();
+}
+
+#if !defined(_WIN32)
+static pid_t spawn(char** argv)
+{
+	pid_t pid = fork();
+	if (pid == 0) {
+		// Keep stdout for the report.
+		dup2(2, 1);
+		execvp(argv[0], argv);
+		perror(argv[0]);
+		_exit(127);
+	}
+	return pid;
+}
+
+static void reap(pid_t pid)
+{
+	if (pid <= 0) {
+		return;
+	}
+	for (int i = 0; i < 100; ++i) {
+		if (waitpid(pid, nullptr, WNOHANG) == pid) {
+			return;
+		}
+		usleep(10000);
+	}
+	kill(pid, SIGTERM);
+	waitpid(pid, nullptr, 0);
+}
+#endif
+
+struct request {
+	const record_entry* entry;
+	int64_t             seq;
+	size_t              stopped;
+};
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		fprintf(stderr, "usage: debugger-replay <recording> <address> [-- <debuggee command...>]\n");
+		return 1;
+	}
+	std::vector<record_entry> entries;
+	if (!read_recording(argv[1], entries)) {
+		fprintf(stderr, "%s: cannot read recording\n", argv[1]);
+		return 1;
+	}
+
+	std::vector<message> recorded;
+	std::vector<request> requests;
+	size_t stopped = 0;
+	for (auto& e : entries) {
+		message m { e.time, e.in, rapidjson::Document() };
+		if (!parse(e.data, m.doc)) {
+			continue;
+		}
+		if (e.in && m.doc.HasMember("seq")) {
+			requests.push_back({ &e, m.doc["seq"].GetInt64(), stopped });
+		}
+		else if (!e.in && m.doc.HasMember("event") && m.doc["event"] == "stopped") {
+			stopped++;
+		}
+		recorded.push_back(std::move(m));
+	}
+
+#if !defined(_WIN32)
+	pid_t child = 0;
+	if (argc > 4 && strcmp(argv[3], "--") == 0) {
+		child = spawn(argv + 4);
+	}
+#else
+	if (argc > 3) {
+		fprintf(stderr, "starting the debuggee is not supported on this platform\n");
+		return 1;
+	}
+#endif
+
+	vscode::io::socket_c client(argv[2]);
+	std::vector<message> replayed;
+	std::set<int64_t> pending;
+	size_t next = 0;
+	stopped = 0;
+	uint64_t progress = vscode::io::record_clock();
+	bool ok = true;
+	while (next < requests.size() || !pending.empty()) {
+		client.update(1);
+		uint64_t now = vscode::io::record_clock();
+		std::string buf;
+		while (client.input(buf)) {
+			message m { now, false, rapidjson::Document() };
+			if (!parse(buf, m.doc) || !m.doc.HasMember("type")) {
+				continue;
+			}
+			if (m.doc["type"] == "response") {
+				pending.erase(m.doc["request_seq"].GetInt64());
+			}
+			else if (m.doc["type"] == "event" && m.doc["event"] == "stopped") {
+				stopped++;
+			}
+			replayed.push_back(std::move(m));
+			progress = now;
+		}
+		if (next < requests.size() && pending.empty() && stopped >= requests[next].stopped && !client.is_closed()) {
+			auto& r = requests[next++];
+			message m { now, true, rapidjson::Document() };
+			parse(r.entry->data, m.doc);
+			client.output(r.entry->data.data(), r.entry->data.size());
+			replayed.push_back(std::move(m));
+			pending.insert(r.seq);
+			progress = now;
+		}
+		if (now - progress > 10 * 1000 * 1000) {
+			fprintf(stderr, "no progress for 10s: %zu of %zu requests sent\n", next, requests.size());
+			ok = false;
+			break;
+		}
+	}
+	client.close();
+#if !defined(_WIN32)
+	reap(child);
+#endif
+
+	latencies_t before = analyze(recorded);
+	latencies_t after = analyze(replayed);
+	rapidjson::StringBuffer sb;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> w(sb);
+	w.StartObject();
+	w.Key("complete");
+	w.Bool(ok);
+	w.Key("requests");
+	w.Uint64(requests.size());
+	w.Key("recorded");
+	report(w, before);
+	w.Key("replayed");
+	report(w, after);
+	w.EndObject();
+	puts(sb.GetString());
+	return ok ? 0 : 1;
+}
@@ -4,6 +4,7 @@
 #include <debugger/luathread.h>
 #include <debugger/io/base.h>
 #include <base/util/unicode.h>
+#include <net/tcp/sndbuffer.h>
 
 namespace vscode
 {
@@ -15,6 +16,7 @@ namespace vscode
 			return;
 		}
 		update_redirect();
+		output_merge_flush(true);
 		if (!attach_) {
 			close_redirect();
 		}
@@ -26,6 +28,13 @@ namespace vscode
 		}
 
 		breakpointmgr_.clear();
+		bump_epoch();
+		outputCoalesced_.clear();
+		outputCoalescedSize_ = 0;
+		outputDropped_ = 0;
+		outputPending_.text.clear();
+		outputRateCount_ = 0;
+		outputSuppressed_ = 0;
 		seq = 1;
 	}
 
@@ -55,7 +64,13 @@ namespace vscode
 		if (args.HasMember("locale") && args["locale"].IsString()) {
 			setlang(args["locale"].Get <std::string>());
 		}
+		// The response itself is always JSON; the client learns the encoding
+		// from it and everything after follows the negotiated one.
+		wprotocol::default_encoding(eEncoding::json);
 		response_initialize(req);
+		if (args.HasMember("encoding") && args["encoding"].IsString() && args["encoding"] == "cbor") {
+			wprotocol::default_encoding(eEncoding::cbor);
+		}
 		set_state(eState::initialized);
 		event_initialized();
 		event_capabilities();
@@ -102,6 +117,39 @@ namespace vscode
 			sourceCoding_ = eCoding::ansi;
 		}
 
+		outputLimit_ = (size_t)config_.get("outputLimit", rapidjson::kNumberType).GetUint64();
+		auto outputPolicy = config_.get("outputPolicy", rapidjson::kStringType).Get<std::string>();
+		if (outputPolicy == "block") {
+			outputPolicy_ = eOutputPolicy::block;
+		}
+		else if (outputPolicy == "coalesce") {
+			outputPolicy_ = eOutputPolicy::coalesce;
+		}
+		else {
+			outputPolicy_ = eOutputPolicy::drop;
+		}
+		outputBlockLimit_.store(outputPolicy_ == eOutputPolicy::block ? outputLimit_ : 0, std::memory_order_relaxed);
+		outputDropLimit_.store(outputPolicy_ == eOutputPolicy::block ? 0 : outputLimit_, std::memory_order_relaxed);
+		outputMergeWindow_ = config_.get("outputMergeWindow", rapidjson::kNumberType).GetInt();
+		outputMergeBytes_ = (size_t)config_.get("outputMergeBytes", rapidjson::kNumberType).GetUint64();
+		outputRate_ = config_.get("outputRate", rapidjson::kNumberType).GetUint();
+		loadedSourceBatch_ = (size_t)config_.get("loadedSourceBatch", rapidjson::kNumberType).GetUint64();
+		loadedSourceLimit_ = (size_t)config_.get("loadedSourceLimit", rapidjson::kNumberType).GetUint64();
+		statsInterval_ = config_.get("statsInterval", rapidjson::kNumberType).GetInt();
+		statsTime_ = std::chrono::steady_clock::now();
+		sourcemgr_.set_limit((size_t)config_.get("sourceCodeLimit", rapidjson::kNumberType).GetUint64());
+		source2client_.set_limit((size_t)config_.get("pathCacheLimit", rapidjson::kNumberType).GetUint64(), 0);
+		breakpointmgr_.set_limit((size_t)config_.get("functionCacheLimit", rapidjson::kNumberType).GetUint64());
+		// Variable references keep the index in their low 16 bits.
+		variableLimit_ = (size_t)config_.get("variableLimit", rapidjson::kNumberType).GetUint64();
+		if (variableLimit_ == 0 || variableLimit_ > 0xFFFF) {
+			variableLimit_ = 0xFFFF;
+		}
+		watchLimit_ = (size_t)config_.get("watchLimit", rapidjson::kNumberType).GetUint64();
+		threadLimit_ = (size_t)config_.get("threadLimit", rapidjson::kNumberType).GetUint64();
+		exceptionmgr_.reset_sites();
+		exceptionmgr_.set_stops((size_t)config_.get("exceptionSiteStops", rapidjson::kNumberType).GetUint64());
+
 		nodebug_ = config_.get("noDebug", rapidjson::kFalseType).GetBool();
 		response_success(req);
 		initproto_ = std::move(req);
@@ -133,7 +181,7 @@ namespace vscode
 	}
 
 	bool debugger_impl::request_threads(rprotocol& req, debug& debug) {
-		response_threads(req);
+		response_threads(req, find_luathread(debug.L()));
 		return false;
 	}
 
@@ -169,7 +217,7 @@ namespace vscode
 						source* s = openVSource();
 						if (s && s->valid) {
 							s->output(res);
-							res("id").Int(threadId << 16 | 0xFFFF);
+							res("id").Uint((unsigned)threadId << 16 | 0xFFFF);
 							res("name").String("");  // TODO
 							res("line").Int(debug.currentline());
 							res("column").Int(1);
@@ -193,7 +241,7 @@ namespace vscode
 							continue;
 						}
 						else {
-							source* s = sourcemgr_.create(&entry);
+							source* s = sourcemgr_.create(&entry, L);
 							if (!s || !s->valid) {
 								depth++;
 								continue;
@@ -209,7 +257,7 @@ namespace vscode
 
 					if (*entry.what == 'C') {
 						for (auto _ : res.Object()) {
-							res("id").Int(threadId << 16 | depth);
+							res("id").Uint((unsigned)threadId << 16 | depth);
 							res("presentationHint").String("label");
 							res("name").String(*entry.what == 'm' ? "[main chunk]" : (entry.name ? entry.name : "?"));
 							res("line").Int(0);
@@ -218,7 +266,7 @@ namespace vscode
 					}
 					else {
 						for (auto _ : res.Object()) {
-							source* s = sourcemgr_.create(&entry);
+							source* s = sourcemgr_.create(&entry, L);
 							if (!s) {
 								// TODO?
 							}
@@ -228,7 +276,7 @@ namespace vscode
 							else {
 								res("presentationHint").String("label");
 							}
-							res("id").Int(threadId << 16 | depth);
+							res("id").Uint((unsigned)threadId << 16 | depth);
 							res("name").String(*entry.what == 'm' ? "[main chunk]" : (entry.name ? entry.name : "?"));
 							res("line").Int(entry.currentline);
 							res("column").Int(1);
@@ -246,7 +294,7 @@ namespace vscode
 		lua_State* L = debug.L();
 		auto& args = req["arguments"];
 		std::string code;
-		if (sourcemgr_.getCode(args["sourceReference"].GetUint(), code)) {
+		if (sourcemgr_.getCode(L, args["sourceReference"].GetUint(), code)) {
 			response_source(req, code);
 		}
 		else {
@@ -263,57 +311,29 @@ namespace vscode
 			response_error(req, "not yet implemented");
 			return false;
 		}
-		for (auto& lt : luathreads_) {
-			lt.second->update_breakpoint();
-		}
 		response_success(req, [&](wprotocol& res)
 		{
 			breakpointmgr_.set_breakpoint(*s, args, res);
 		});
+		bump_epoch();
 		return false;
 	}
 
 	bool debugger_impl::request_set_exception_breakpoints(rprotocol& req)
 	{
-		auto& args = req["arguments"];
-		exception_.clear();
-		if (args.HasMember("filters") && args["filters"].IsArray()) {
-			for (auto& v : args["filters"].GetArray()) {
-				if (v.IsString()) {
-					std::string filter = v.Get<std::string>();
-					if (filter == "all") {
-						exception_.insert(eException::lua_panic);
-						exception_.insert(eException::lua_pcall);
-						exception_.insert(eException::xpcall);
-						exception_.insert(eException::pcall);
-					}
-					else if (filter == "lua_panic") {
-						exception_.insert(eException::lua_panic);
-					}
-					else if (filter == "lua_pcall") {
-						exception_.insert(eException::lua_pcall);
-					}
-					else if (filter == "pcall") {
-						exception_.insert(eException::pcall);
-					}
-					else if (filter == "xpcall") {
-						exception_.insert(eException::xpcall);
-					}
-				}
-			}
-
-		}
+		exceptionmgr_.set_breakpoints(req["arguments"]);
+		bump_epoch();
 		response_success(req);
 		return false;
 	}
 
 	bool debugger_impl::request_scopes(rprotocol& req, debug& debug) {
 		auto& args = req["arguments"];
-		if (!args.HasMember("frameId")) {
+		if (!args.HasMember("frameId") || !args["frameId"].IsUint()) {
 			response_error(req, "Not found frame");
 			return false;
 		}
-		int threadAndFrameId = args["frameId"].GetInt();
+		unsigned threadAndFrameId = args["frameId"].GetUint();
 		int threadId = threadAndFrameId >> 16;
 		int frameId = threadAndFrameId & 0xFFFF;
 		luathread* thread = find_luathread(threadId);
@@ -452,15 +472,189 @@ namespace vscode
 		return true;
 	}
 
+	bool debugger_impl::request_debugger_stats(rprotocol& req)
+	{
+		auto& args = req["arguments"];
+		bool reset = args.HasMember("reset") && args["reset"].IsBool() && args["reset"].GetBool();
+		response_success(req, [&](wprotocol& res)
+		{
+			memory_usage variables { 0, 0, variableLimit_ };
+			memory_usage watches { 0, 0, watchLimit_ };
+			for (luathread* lt : luathreads_) {
+				lt->ob_.usage(variables, watches);
+			}
+			memory_usage paths { source2client_.size(), source2client_.bytes(), source2client_.max_entries() };
+			for (auto _ : res("memory").Object())
+			{
+				for (auto _ : res("sourceCode").Object())
+				{
+					sourcemgr_.code_usage().output(res);
+				}
+				for (auto _ : res("pathCache").Object())
+				{
+					paths.output(res);
+				}
+				for (auto _ : res("chunkNames").Object())
+				{
+					sourcemgr_.chunk_usage().output(res);
+				}
+				for (auto _ : res("functionCache").Object())
+				{
+					breakpointmgr_.function_usage().output(res);
+				}
+				for (auto _ : res("exceptionSites").Object())
+				{
+					exceptionmgr_.site_usage().output(res);
+				}
+				for (auto _ : res("variables").Object())
+				{
+					variables.output(res);
+				}
+				for (auto _ : res("watches").Object())
+				{
+					watches.output(res);
+				}
+			}
+#if !defined(DEBUGGER_DISABLE_STATS)
+			auto& c = stats_;
+			res("uptime").Int64(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - c.since).count());
+			for (auto _ : res("hook").Object())
+			{
+				// Events handled without thread_ are counted per thread.
+				uint64_t types[hook_stats::unlocked_count];
+				for (size_t i = 0; i < hook_stats::unlocked_count; ++i) {
+					types[i] = c.counters[i];
+				}
+				uint64_t unlocked = 0;
+				for (luathread* lt : luathreads_) {
+					for (size_t i = 0; i < hook_stats::unlocked_count; ++i) {
+						uint64_t n = lt->stats.unlocked[i].get();
+						types[i] += n;
+						unlocked += n;
+					}
+				}
+				res("call").Uint64(types[(size_t)eStat::hook_call]);
+				res("return").Uint64(types[(size_t)eStat::hook_return]);
+				res("line").Uint64(types[(size_t)eStat::hook_line]);
+				res("exception").Uint64(types[(size_t)eStat::hook_exception]);
+				res("unlocked").Uint64(unlocked);
+				for (auto _ : res("time").Object())
+				{
+					c.hook_time.output(res);
+				}
+			}
+			for (auto _ : res("threads").Array())
+			{
+				for (luathread* lt : luathreads_)
+				{
+					for (auto _ : res.Object())
+					{
+						res("id").Int(lt->id);
+						res("events").Uint64(lt->stats.events);
+						res("unlocked").Uint64(lt->stats.unlocked_total());
+						for (auto _ : res("time").Object())
+						{
+							lt->stats.time.output(res);
+						}
+					}
+				}
+			}
+			for (auto _ : res("breakpoints").Object())
+			{
+				res("functionHits").Uint64(c.get(eStat::get_function_hit));
+				res("functionMisses").Uint64(c.get(eStat::get_function_miss));
+				res("conditions").Uint64(c.get(eStat::condition));
+				for (auto _ : res("conditionTime").Object())
+				{
+					c.condition_time.output(res);
+				}
+			}
+			for (auto _ : res("pathConvert").Object())
+			{
+				res("hits").Uint64(c.get(eStat::path_convert_hit));
+				res("misses").Uint64(c.get(eStat::path_convert_miss));
+			}
+			for (auto _ : res("sourceCache").Object())
+			{
+				res("hits").Uint64(c.get(eStat::source_hit));
+				res("misses").Uint64(c.get(eStat::source_miss));
+			}
+			for (auto _ : res("io").Object())
+			{
+				res("bytesSent").Uint64(c.get(eStat::bytes_sent));
+				res("bytesReceived").Uint64(c.get(eStat::bytes_received));
+				res("messagesSent").Uint64(c.get(eStat::messages_sent));
+				res("messagesReceived").Uint64(c.get(eStat::messages_received));
+				res("sendQueue").Uint64(network_->send_size());
+				net::tcp::chunk_pool_stats pool = net::tcp::stream_chunk_pool::stats();
+				for (auto _ : res("chunkPool").Object())
+				{
+					res("pooled").Uint64(pool.pooled);
+					res("outstanding").Uint64(pool.outstanding);
+					res("peak").Uint64(pool.peak);
+					res("limit").Uint64(pool.limit);
+				}
+			}
+			for (auto _ : res("output").Object())
+			{
+				res("queue").Uint64(output_queued());
+				res("pending").Uint64(outputPending_.text.size());
+				res("droppedMessages").Uint64(outputStats_.dropped_messages);
+				res("droppedBytes").Uint64(outputStats_.dropped_bytes);
+				res("coalescedBytes").Uint64(outputStats_.coalesced_bytes);
+				res("mergedMessages").Uint64(outputStats_.merged_messages);
+				res("suppressedLines").Uint64(outputStats_.suppressed_lines);
+			}
+			res("sources").Uint64(sourcemgr_.size());
+#endif
+		});
+#if !defined(DEBUGGER_DISABLE_STATS)
+		if (reset) {
+			stats_.reset();
+			for (luathread* lt : luathreads_) {
+				lt->stats.reset();
+			}
+		}
+#endif
+		return false;
+	}
+
+	bool debugger_impl::request_exception_sites(rprotocol& req)
+	{
+		auto& args = req["arguments"];
+		size_t count = 20;
+		if (args.HasMember("count") && args["count"].IsUint()) {
+			count = args["count"].GetUint();
+		}
+		bool reset = args.HasMember("reset") && args["reset"].IsBool() && args["reset"].GetBool();
+		response_success(req, [&](wprotocol& res)
+		{
+			exceptionmgr_.output_sites(res, count, [&](const std::string& source, wprotocol& res)
+			{
+				std::string client;
+				if (path_convert(source, client)) {
+					res("path").String(path_clientrelative(client));
+				}
+				else {
+					res("name").String(source);
+				}
+			});
+		});
+		if (reset) {
+			exceptionmgr_.reset_sites();
+		}
+		return false;
+	}
+
 	bool debugger_impl::request_evaluate(rprotocol& req, debug& debug)
 	{
 		lua_State* L = debug.L();
 		auto& args = req["arguments"];
-		if (!args.HasMember("frameId")) {
+		if (!args.HasMember("frameId") || !args["frameId"].IsUint()) {
 			response_error(req, "Not yet implemented.");
 			return false;
 		}
-		int threadAndFrameId = args["frameId"].GetInt();
+		unsigned threadAndFrameId = args["frameId"].GetUint();
 		int threadId = threadAndFrameId >> 16;
 		int frameId = threadAndFrameId & 0xFFFF;
 		luathread* thread = find_luathread(threadId);
@@ -513,9 +707,12 @@ namespace vscode
 
 	bool debugger_impl::request_loaded_sources(rprotocol& req, debug& debug)
 	{
+		auto& args = req["arguments"];
+		size_t start = args.HasMember("start") && args["start"].IsUint() ? args["start"].GetUint() : 0;
+		size_t count = args.HasMember("count") && args["count"].IsUint() ? args["count"].GetUint() : 0;
 		response_success(req, [&](wprotocol& res)
 		{
-			sourcemgr_.loadedSources(res);
+			sourcemgr_.loadedSources(res, start, count);
 		});
 		return false;
 	}
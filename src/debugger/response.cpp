@@ -24,13 +24,28 @@ namespace vscode
             for (auto _ : res("body").Object())
             {
                 capabilities(res);
+                auto& args = req["arguments"];
+                res("encoding").String(args.HasMember("encoding") && args["encoding"] == "cbor" ? "cbor" : "json");
             }
 		}
 		io_output(res);
 	}
 
-	void debugger_impl::response_threads(rprotocol& req)
+	// One page of threads in id order: `start` and `count` come from the
+	// request, `count` defaulting to threadLimit. The first page always
+	// begins with `current`, the thread that is stopped.
+	void debugger_impl::response_threads(rprotocol& req, luathread* current)
 	{
+		size_t start = 0;
+		size_t count = threadLimit_;
+		if (req.HasMember("arguments") && req["arguments"].IsObject()) {
+			auto& args = req["arguments"];
+			if (args.HasMember("start") && args["start"].IsUint()) start = args["start"].GetUint();
+			if (args.HasMember("count") && args["count"].IsUint()) count = args["count"].GetUint();
+		}
+		if (count == 0) {
+			count = luathreads_.size();
+		}
 		wprotocol res;
 		for (auto _ : res.Object())
 		{
@@ -43,15 +58,38 @@ namespace vscode
 			{
 				for (auto _ : res("threads").Array())
 				{
-					for (auto& lt : luathreads_) 
-					{
+					auto output = [&](luathread* lt) {
+						char name[32];
+						int len = snprintf(name, sizeof name, "Thread %d", lt->id);
 						for (auto _ : res.Object())
 						{
-							res("name").String(base::format("Thread %d", lt.second->id));
-							res("id").Int(lt.second->id);
+							res("name").String(name, (rapidjson::SizeType)len);
+							res("id").Int(lt->id);
+						}
+					};
+					// Pages are taken from one order on every request: the
+					// current thread first, then the others by id.
+					size_t pos = 0;
+					auto page = [&](luathread* lt) {
+						if (pos >= start && pos < start + count) {
+							output(lt);
+						}
+						pos++;
+					};
+					if (current) {
+						page(current);
+					}
+					for (luathread* lt : luathreads_)
+					{
+						if (pos >= start + count) {
+							break;
+						}
+						if (lt != current) {
+							page(lt);
 						}
 					}
 				}
+				res("totalThreads").Uint64(luathreads_.size());
 			}
 		}
 		io_output(res);
@@ -2,6 +2,10 @@
 #include <debugger/source.h>
 #include <debugger/breakpoint.h>
 #include <debugger/crc32.h>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string.h>
 
 namespace vscode {
 
@@ -33,19 +37,215 @@ namespace vscode {
 		}
 	}
 
+	// Registry key of a weak-valued table, ref -> a function of that chunk.
+	static int CODE_TABLE = 0;
+
+	static void code_table(lua_State* L)
+	{
+		if (LUA_TTABLE != lua_rawgetp(L, LUA_REGISTRYINDEX, &CODE_TABLE)) {
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_newtable(L);
+			lua_pushstring(L, "v");
+			lua_setfield(L, -2, "__mode");
+			lua_setmetatable(L, -2);
+			lua_pushvalue(L, -1);
+			lua_rawsetp(L, LUA_REGISTRYINDEX, &CODE_TABLE);
+		}
+	}
+
+	// Registry key of a weak-keyed table, function -> ref, so a function
+	// seen before finds its chunk without hashing the text again.
+	static int FUNC_TABLE = 0;
+
+	static void func_table(lua_State* L)
+	{
+		if (LUA_TTABLE != lua_rawgetp(L, LUA_REGISTRYINDEX, &FUNC_TABLE)) {
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_newtable(L);
+			lua_pushstring(L, "k");
+			lua_setfield(L, -2, "__mode");
+			lua_setmetatable(L, -2);
+			lua_pushvalue(L, -1);
+			lua_rawsetp(L, LUA_REGISTRYINDEX, &FUNC_TABLE);
+		}
+	}
+
+	static lua_State* get_mainthread(lua_State* L)
+	{
+		lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+		lua_State* ml = lua_tothread(L, -1);
+		lua_pop(L, 1);
+		return ml;
+	}
+
+	static inline uint64_t rotl(uint64_t x, int b)
+	{
+		return (x << b) | (x >> (64 - b));
+	}
+
+	static inline void sipround(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3)
+	{
+		v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+		v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+		v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+		v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+	}
+
+	// SipHash-2-4.
+	static uint64_t siphash(const uint64_t k[2], const unsigned char* p, size_t len)
+	{
+		uint64_t v0 = k[0] ^ 0x736f6d6570736575ULL;
+		uint64_t v1 = k[1] ^ 0x646f72616e646f6dULL;
+		uint64_t v2 = k[0] ^ 0x6c7967656e657261ULL;
+		uint64_t v3 = k[1] ^ 0x7465646279746573ULL;
+		const unsigned char* end = p + (len & ~(size_t)7);
+		for (; p != end; p += 8) {
+			uint64_t m;
+			memcpy(&m, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			m = __builtin_bswap64(m);
+#endif
+			v3 ^= m;
+			sipround(v0, v1, v2, v3);
+			sipround(v0, v1, v2, v3);
+			v0 ^= m;
+		}
+		uint64_t b = (uint64_t)len << 56;
+		for (size_t i = 0; i < (len & 7); ++i) {
+			b |= (uint64_t)p[i] << (8 * i);
+		}
+		v3 ^= b;
+		sipround(v0, v1, v2, v3);
+		sipround(v0, v1, v2, v3);
+		v0 ^= b;
+		v2 ^= 0xff;
+		for (int i = 0; i < 4; ++i) {
+			sipround(v0, v1, v2, v3);
+		}
+		return v0 ^ v1 ^ v2 ^ v3;
+	}
+
+	// Chunks that share a key share a source, and their text is never
+	// compared, so the key is SipHash under a key picked per process: texts
+	// that collide can't be made up in advance. It is only stable within
+	// the process; sourceReference is seeded from CRC-32 instead.
+	static uint64_t codeKey(const char* code, size_t len)
+	{
+		static const struct sipkey {
+			uint64_t k[2];
+			sipkey() {
+				std::random_device rd;
+				k[0] = ((uint64_t)rd() << 32) | rd();
+				k[1] = ((uint64_t)rd() << 32) | rd();
+			}
+		} key;
+		return siphash(key.k, (const unsigned char*)code, len);
+	}
+
+	static uint32_t codeSeed(const char* code, size_t len)
+	{
+		return crc32((const unsigned char*)code, len);
+	}
+
+	static std::atomic<uint32_t> generations(0);
+
 	sourceMgr::sourceMgr(debugger_impl& dbg)
 		: dbg_(dbg)
+		, generation_(++generations)
 	{ }
 
-	source* sourceMgr::create(lua::Debug* ar) {
-		if (ar->source[0] == '@' || ar->source[0] == '=') {
+	// Registry key of a weak-valued table whose only value is an empty
+	// table. The collector clears it in the atomic phase, before it frees
+	// any string found dead in that cycle, so while it is still there no
+	// chunk name seen since it was set can have been freed and reused.
+	static int GC_SENTINEL = 0;
+
+	static bool gc_sentinel(lua_State* L)
+	{
+		if (LUA_TTABLE != lua_rawgetp(L, LUA_REGISTRYINDEX, &GC_SENTINEL)) {
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_newtable(L);
+			lua_pushstring(L, "v");
+			lua_setfield(L, -2, "__mode");
+			lua_setmetatable(L, -2);
+			lua_pushvalue(L, -1);
+			lua_rawsetp(L, LUA_REGISTRYINDEX, &GC_SENTINEL);
+		}
+		bool intact = LUA_TTABLE == lua_rawgeti(L, -1, 1);
+		lua_pop(L, 1);
+		if (!intact) {
+			lua_newtable(L);
+			lua_rawseti(L, -2, 1);
+		}
+		lua_pop(L, 1);
+		return intact;
+	}
+
+	// Entries kept per state.
+	static const size_t chunk_limit = 8192;
+
+	// With L, `ar` must be an activation record of L, or the chunk's
+	// function must be at `fidx`; the text is then captured lazily.
+	//
+	// Chunk names are strings owned by the VM, so with L the source is
+	// first looked up by the address of `ar->source`, in a cache of that
+	// state's own. The cache is dropped whenever a collection of the state
+	// may have freed one of the names it holds, or the state is detached.
+	source* sourceMgr::create(lua::Debug* ar, lua_State* L, int fidx) {
+		if (!L) {
+			return createByChunk(ar, L, fidx);
+		}
+		chunk_map& chunks = chunks_[get_mainthread(L)];
+		if (!gc_sentinel(L)) {
+			chunks.clear();
+		}
+		auto it = chunks.find(ar->source);
+		if (it != chunks.end() && (!it->second.code || it->second.code->L)) {
+			DEBUGGER_STATS_ADD(dbg_.stats(), source_hit, 1);
+			return it->second.s;
+		}
+		DEBUGGER_STATS_ADD(dbg_.stats(), source_miss, 1);
+		source* s = createByChunk(ar, L, fidx);
+		cacheChunk(chunks, ar->source, s);
+		return s;
+	}
+
+	source* sourceMgr::createByChunk(lua::Debug* ar, lua_State* L, int fidx) {
+		const char* chunkname = ar->source;
+		if (chunkname[0] == '@' || chunkname[0] == '=') {
+			return create(chunkname);
+		}
+		return createByRef(chunkname, strlen(chunkname), L, ar, fidx);
+	}
+
+	// An in-memory chunk is only cached while its text can be recalled from
+	// a function, so that a hit never skips capturing it.
+	void sourceMgr::cacheChunk(chunk_map& chunks, const char* chunkname, source* s) {
+		code_entry* code = nullptr;
+		if (s && s->ref) {
+			code = &codes_.find(s->ref)->second;
+			if (!code->L) {
+				return;
+			}
+		}
+		if (chunks.size() >= chunk_limit) {
+			chunks.clear();
+		}
+		chunks[chunkname] = chunk_entry { s, code };
+	}
+
+	source* sourceMgr::create(const char* chunkname) {
+		if (chunkname[0] == '@' || chunkname[0] == '=') {
 			std::string path;
-			if (dbg_.path_convert(ar->source, path)) {
+			if (dbg_.path_convert(chunkname, path)) {
 				return createByPath(path);
 			}
 		}
 		else {
-			return createByRef(ar->source);
+			return createByRef(chunkname, strlen(chunkname), nullptr, nullptr, 0);
 		}
 		return nullptr;
 	}
@@ -80,23 +280,237 @@ namespace vscode {
 		source* s = &(res.first->second);
 		s->valid = true;
 		s->path = path;
-		dbg_.event_loadedsource("new", s);
+		sources_.push_back(s);
 		return s;
 	}
 
-	source* sourceMgr::createByRef(const std::string& code) {
-		int32_t hash = codeHash(code);
-		auto it = poolRef_.find(hash);
-		if (it != poolRef_.end()) {
-			return &(it->second);
+	source* sourceMgr::createByRef(const char* code, size_t len) {
+		return createByRef(code, len, nullptr, nullptr, 0);
+	}
+
+	// Chunks are identified by content, so loading the same text again maps
+	// to the same source. The text itself is kept only when no function of
+	// the chunk can be referenced, or once it has been asked for. With L the
+	// function is looked up first, and only a function not seen before
+	// pays for hashing the text.
+	source* sourceMgr::createByRef(const char* code, size_t len, lua_State* L, lua::Debug* ar, int fidx) {
+		bool hasf = false;
+		if (L && fidx) {
+			lua_pushvalue(L, fidx);
+			hasf = true;
+		}
+		else if (L && ar && lua_getinfo(L, "f", (lua_Debug*)ar)) {
+			hasf = true;
+		}
+		if (hasf) {
+			func_table(L);
+			lua_pushvalue(L, -2);
+			uint32_t ref = (uint32_t)(LUA_TNUMBER == lua_rawget(L, -2) ? lua_tointeger(L, -1) : 0);
+			lua_pop(L, 2);
+			auto c = codes_.find(ref);
+			if (c != codes_.end() && (c->second.L || poolCode_.get(c->second.key))) {
+				lua_pop(L, 1);
+				return &poolRef_.find(ref)->second;
+			}
+		}
+		uint64_t key = codeKey(code, len);
+		uint32_t ref;
+		auto it = codeRef_.find(key);
+		if (it != codeRef_.end()) {
+			ref = it->second;
+		}
+		else {
+			ref = newRef(key, codeSeed(code, len));
+		}
+		if (hasf) {
+			if (!codes_[ref].L) {
+				remember(ref, L, -1);
+			}
+			func_table(L);
+			lua_pushvalue(L, -2);
+			lua_pushinteger(L, ref);
+			lua_rawset(L, -3);
+			lua_pop(L, 2);
+		}
+		else if (!codes_[ref].L && !poolCode_.get(key)) {
+			capture(key, code, len);
+		}
+		return &poolRef_.find(ref)->second;
+	}
+
+	// Source of an in-memory chunk queued by outputKey. The first record of
+	// a function carries the text; a key not seen before and without it is
+	// only possible if that record was discarded, and gets no source.
+	source* sourceMgr::createByKey(uint64_t key, const std::string& code) {
+		uint32_t ref;
+		auto it = codeRef_.find(key);
+		if (it != codeRef_.end()) {
+			ref = it->second;
+		}
+		else if (!code.empty()) {
+			ref = newRef(key, codeSeed(code.data(), code.size()));
+		}
+		else {
+			return nullptr;
+		}
+		if (!code.empty() && !codes_[ref].L && !poolCode_.get(key)) {
+			capture(key, code.data(), code.size());
 		}
-		auto res = poolRef_.insert(std::make_pair(hash, source()));
+		return &poolRef_.find(ref)->second;
+	}
+
+	// Registry key of a weak-keyed table, function -> content key, kept by
+	// printing threads for themselves. [1] holds the generation of the
+	// sourceMgr it was filled for, as keys it knows are lost with it.
+	static int OUTPUT_TABLE = 0;
+
+	static void output_table(lua_State* L, uint32_t generation)
+	{
+		if (LUA_TTABLE == lua_rawgetp(L, LUA_REGISTRYINDEX, &OUTPUT_TABLE)) {
+			bool same = LUA_TNUMBER == lua_rawgeti(L, -1, 1) && (uint32_t)lua_tointeger(L, -1) == generation;
+			lua_pop(L, 1);
+			if (same) {
+				return;
+			}
+		}
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_newtable(L);
+		lua_pushstring(L, "k");
+		lua_setfield(L, -2, "__mode");
+		lua_setmetatable(L, -2);
+		lua_pushinteger(L, generation);
+		lua_rawseti(L, -2, 1);
+		lua_pushvalue(L, -1);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, &OUTPUT_TABLE);
+	}
+
+	// Called on the thread running L without thread_, so it only touches
+	// L. `ar` must be an activation record of an in-memory chunk. Sets
+	// `code` to its text unless outputSeen was called for the function.
+	bool sourceMgr::outputKey(lua_State* L, lua::Debug* ar, uint64_t& key, std::string& code) const {
+		if (!lua_getinfo(L, "f", (lua_Debug*)ar)) {
+			return false;
+		}
+		output_table(L, generation_);
+		lua_pushvalue(L, -2);
+		if (LUA_TNUMBER == lua_rawget(L, -2)) {
+			key = (uint64_t)lua_tointeger(L, -1);
+			lua_pop(L, 3);
+			return true;
+		}
+		lua_pop(L, 3);
+		code = ar->source;
+		key = codeKey(code.data(), code.size());
+		return true;
+	}
+
+	// Remembers that the text of the function of `ar` was queued.
+	void sourceMgr::outputSeen(lua_State* L, lua::Debug* ar, uint64_t key) const {
+		if (!lua_getinfo(L, "f", (lua_Debug*)ar)) {
+			return;
+		}
+		output_table(L, generation_);
+		lua_pushvalue(L, -2);
+		lua_pushinteger(L, (lua_Integer)key);
+		lua_rawset(L, -3);
+		lua_pop(L, 2);
+	}
+
+	// References start from the CRC-32 of the text, so they stay stable
+	// across sessions unless two chunks collide on it.
+	uint32_t sourceMgr::newRef(uint64_t key, uint32_t seed) {
+		uint32_t ref = seed;
+		while (ref == 0 || codes_.find(ref) != codes_.end()) {
+			ref++;
+		}
+		codeRef_.insert(std::make_pair(key, ref));
+		codes_.insert(std::make_pair(ref, code_entry { key, nullptr }));
+		auto res = poolRef_.insert(std::make_pair(ref, source()));
 		assert(res.second);
 		source* s = &(res.first->second);
 		s->valid = true;
-		s->ref = hash;
-		dbg_.event_loadedsource("new", s);
-		return s;
+		s->ref = ref;
+		sources_.push_back(s);
+		return ref;
+	}
+
+	void sourceMgr::remember(uint32_t ref, lua_State* L, int fidx) {
+		fidx = lua_absindex(L, fidx);
+		code_table(L);
+		lua_pushvalue(L, fidx);
+		lua_rawseti(L, -2, ref);
+		lua_pop(L, 1);
+		codes_[ref].L = get_mainthread(L);
+	}
+
+	// Copies the text out of a live function of the chunk, if there still is
+	// one. L must belong to the calling thread.
+	bool sourceMgr::recall(code_entry& e, uint32_t ref, lua_State* L, std::string& code) {
+		code_table(L);
+		if (LUA_TFUNCTION != lua_rawgeti(L, -1, ref)) {
+			lua_pop(L, 2);
+			e.L = nullptr;
+			return false;
+		}
+		lua::Debug entry;
+		lua_getinfo(L, ">S", (lua_Debug*)&entry);
+		lua_pop(L, 1);
+		code = entry.source;
+		capture(e.key, code.data(), code.size());
+		return true;
+	}
+
+	void sourceMgr::capture(uint64_t key, const char* code, size_t len) {
+		packed_code packed { false, std::string() };
+		if (len >= 64) {
+			if (!lz4_) {
+				lz4_.reset(new io::lz4::context);
+			}
+			io::lz4::compress(*lz4_, code, len, packed.data);
+			packed.lz4 = packed.data.size() < len;
+		}
+		if (!packed.lz4) {
+			packed.data.assign(code, len);
+		}
+		packed.data.shrink_to_fit();
+		size_t cost = packed.data.size();
+		poolCode_.put(key, std::move(packed), cost);
+	}
+
+	bool sourceMgr::unpack(uint64_t key, std::string& code) {
+		packed_code* packed = poolCode_.get(key);
+		if (!packed) {
+			return false;
+		}
+		if (!packed->lz4) {
+			code = packed->data;
+			return true;
+		}
+		return io::lz4::decompress(packed->data.data(), packed->data.size(), code);
+	}
+
+	// Captures (or just forgets) the chunks whose text is only reachable
+	// through L, which is going away. L == nullptr forgets every state.
+	void sourceMgr::detach(lua_State* L, bool capture) {
+		lua_State* ml = L ? get_mainthread(L) : nullptr;
+		if (ml) {
+			chunks_.erase(ml);
+		}
+		else {
+			chunks_.clear();
+		}
+		for (auto& c : codes_) {
+			code_entry& e = c.second;
+			if (!e.L || (ml && e.L != ml)) {
+				continue;
+			}
+			if (capture && L && !poolCode_.get(e.key)) {
+				std::string code;
+				recall(e, c.first, L, code);
+			}
+			e.L = nullptr;
+		}
 	}
 
 	source* sourceMgr::openByPath(const std::string& path) {
@@ -115,41 +529,61 @@ namespace vscode {
 		return nullptr;
 	}
 
-	void sourceMgr::loadedSources(wprotocol& res)
+	void sourceMgr::loadedSources(wprotocol& res, size_t start, size_t count)
 	{
+		start = std::min(start, sources_.size());
+		size_t end = (count && count < sources_.size() - start) ? start + count : sources_.size();
 		for (auto _ : res("sources").Array()) {
-			for (auto& p : poolPath_) {
-				p.second.output(res);
-			}
-			for (auto& p : poolRef_) {
-				p.second.output(res);
+			for (size_t i = start; i < end; ++i) {
+				sources_[i]->output(res);
 			}
 		}
+		res("totalSources").Uint64(sources_.size());
+	}
+
+	// Sends loadedSource events for at most `batch` sources created since
+	// the last call. Once more than `limit` sources exist, the remaining
+	// events are skipped and the client has to page through loadedSources.
+	void sourceMgr::update(size_t batch, size_t limit)
+	{
+		if (limit && sources_.size() > limit) {
+			notified_ = sources_.size();
+			return;
+		}
+		size_t end = (batch && batch < sources_.size() - notified_) ? notified_ + batch : sources_.size();
+		for (; notified_ < end; ++notified_) {
+			dbg_.event_loadedsource("new", sources_[notified_]);
+		}
 	}
 
-	bool sourceMgr::getCode(uint32_t ref, std::string& code) {
-		auto it = poolCode_.find(ref);
-		if (it != poolCode_.end()) {
-			code = it->second;
+	bool sourceMgr::getCode(lua_State* L, uint32_t ref, std::string& code) {
+		auto it = codes_.find(ref);
+		if (it == codes_.end()) {
+			return false;
+		}
+		code_entry& e = it->second;
+		if (unpack(e.key, code)) {
 			return true;
 		}
-		return false;
+		return L && e.L && e.L == get_mainthread(L) && recall(e, ref, L, code);
 	}
 
-	uint32_t sourceMgr::codeHash(const std::string& s) {
-		uint32_t hash = crc32((const unsigned char*)s.data(), s.size());
-		for (;;) {
-			auto it = poolCode_.find(hash);
-			if (it != poolCode_.end()) {
-				if (it->second == s) {
-					return hash;
-				}
-				hash++;
-			}
-			else {
-				poolCode_.insert(std::make_pair(hash, s));
-				return hash;
-			}
+	void sourceMgr::set_limit(size_t bytes) {
+		poolCode_.set_limit(0, bytes);
+	}
+
+	memory_usage sourceMgr::code_usage() const {
+		size_t overhead = codes_.size() * (sizeof(code_entry) + sizeof(uint64_t) + 2 * sizeof(uint32_t) + 8 * sizeof(void*));
+		return { codes_.size(), poolCode_.bytes() + overhead, poolCode_.max_bytes() };
+	}
+
+	memory_usage sourceMgr::chunk_usage() const {
+		size_t count = 0;
+		size_t bytes = chunks_.size() * (sizeof(lua_State*) + sizeof(chunk_map) + 2 * sizeof(void*)) + chunks_.bucket_count() * sizeof(void*);
+		for (auto& chunks : chunks_) {
+			count += chunks.second.size();
+			bytes += chunks.second.size() * (sizeof(const char*) + sizeof(chunk_entry) + 2 * sizeof(void*)) + chunks.second.bucket_count() * sizeof(void*);
 		}
+		return { count, bytes, chunk_limit * chunks_.size() };
 	}
 }
@@ -0,0 +1,123 @@
+#include <debugger/stats.h>
+#include <debugger/protocol.h>
+#include <algorithm>
+#include <string.h>
+
+namespace vscode
+{
+	static int highest_bit(uint64_t v)
+	{
+		int n = 0;
+		for (int shift = 32; shift > 0; shift >>= 1) {
+			if (v >> shift) {
+				v >>= shift;
+				n += shift;
+			}
+		}
+		return n;
+	}
+
+	static size_t bucket_index(uint64_t v)
+	{
+		if (v < histogram::sub_count) {
+			return (size_t)v;
+		}
+		int e = highest_bit(v);
+		int shift = e - histogram::sub_bits;
+		return (size_t)(shift + 1) * histogram::sub_count + (size_t)((v >> shift) & (histogram::sub_count - 1));
+	}
+
+	// Middle of the range covered by a bucket.
+	static uint64_t bucket_value(size_t idx)
+	{
+		if (idx < histogram::sub_count) {
+			return idx;
+		}
+		int shift = (int)(idx / histogram::sub_count) - 1;
+		uint64_t m = idx % histogram::sub_count;
+		return ((histogram::sub_count + m) << shift) + ((uint64_t(1) << shift) >> 1);
+	}
+
+	void histogram::record(uint64_t v)
+	{
+		if (count == 0 || v < min) {
+			min = v;
+		}
+		if (v > max) {
+			max = v;
+		}
+		count++;
+		sum += v;
+		buckets[bucket_index(v)]++;
+	}
+
+	uint64_t histogram::percentile(double q) const
+	{
+		if (count == 0) {
+			return 0;
+		}
+		uint64_t rank = (uint64_t)(q * count);
+		if (rank >= count) {
+			rank = count - 1;
+		}
+		uint64_t seen = 0;
+		for (size_t i = 0; i < bucket_count; ++i) {
+			seen += buckets[i];
+			if (seen > rank) {
+				return std::min(std::max(bucket_value(i), min), max);
+			}
+		}
+		return max;
+	}
+
+	void histogram::output(wprotocol& res) const
+	{
+		res("count").Uint64(count);
+		res("min").Uint64(min);
+		res("max").Uint64(max);
+		res("mean").Uint64(count ? sum / count : 0);
+		res("p50").Uint64(percentile(0.5));
+		res("p90").Uint64(percentile(0.9));
+		res("p99").Uint64(percentile(0.99));
+		res("p999").Uint64(percentile(0.999));
+	}
+
+	void histogram::reset()
+	{
+		count = sum = min = max = 0;
+		memset(buckets, 0, sizeof buckets);
+	}
+
+	void memory_usage::output(wprotocol& res) const
+	{
+		res("entries").Uint64(entries);
+		res("bytes").Uint64(bytes);
+		res("limit").Uint64(limit);
+	}
+
+	void debugger_stats::reset()
+	{
+		memset(counters, 0, sizeof counters);
+		hook_time.reset();
+		condition_time.reset();
+		since = std::chrono::steady_clock::now();
+	}
+
+	uint64_t hook_stats::unlocked_total() const
+	{
+		uint64_t n = 0;
+		for (auto& c : unlocked) {
+			n += c.get();
+		}
+		return n;
+	}
+
+	void hook_stats::reset()
+	{
+		events = 0;
+		time.reset();
+		for (auto& c : unlocked) {
+			c.reset();
+		}
+	}
+}
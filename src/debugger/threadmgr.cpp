@@ -0,0 +1,90 @@
+#include <debugger/threadmgr.h>
+#include <debugger/luathread.h>
+#include <debugger/lua.h>
+#include <algorithm>
+#include <functional>
+
+namespace vscode
+{
+	static lua_State* get_mainthread(lua_State* L)
+	{
+		lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+		lua_State* ml = lua_tothread(L, -1);
+		lua_pop(L, 1);
+		return ml;
+	}
+
+	threadMgr::~threadMgr()
+	{ }
+
+	luathread* threadMgr::find(lua_State* L) const
+	{
+		if (states_.empty()) {
+			return nullptr;
+		}
+		auto it = states_.find(L);
+		if (it != states_.end()) {
+			return it->second;
+		}
+		lua_State* ml = get_mainthread(L);
+		if (ml == L) {
+			return nullptr;
+		}
+		it = states_.find(ml);
+		return it != states_.end() ? it->second : nullptr;
+	}
+
+	luathread* threadMgr::find(int id) const
+	{
+		if (id <= 0 || (size_t)id > slots_.size()) {
+			return nullptr;
+		}
+		return slots_[id - 1].get();
+	}
+
+	luathread* threadMgr::create(debugger_impl& dbg, lua_State* L)
+	{
+		L = get_mainthread(L);
+		int id = 0;
+		while (!free_.empty() && !id) {
+			std::pop_heap(free_.begin(), free_.end(), std::greater<int>());
+			id = free_.back();
+			free_.pop_back();
+			if ((size_t)id > slots_.size()) {
+				id = 0;
+			}
+		}
+		if (!id) {
+			if (slots_.size() >= (size_t)max_id) {
+				return nullptr;
+			}
+			slots_.emplace_back();
+			id = (int)slots_.size();
+		}
+		luathread* thread = new luathread(id, dbg, L);
+		slots_[id - 1].reset(thread);
+		states_.insert(std::make_pair(L, thread));
+		return thread;
+	}
+
+	void threadMgr::erase(luathread* thread)
+	{
+		int id = thread->id;
+		states_.erase(thread->L);
+		slots_[id - 1].reset();
+		free_.push_back(id);
+		std::push_heap(free_.begin(), free_.end(), std::greater<int>());
+		// Trailing free slots are dropped; their ids left in the heap are
+		// skipped when popped.
+		while (!slots_.empty() && !slots_.back()) {
+			slots_.pop_back();
+		}
+	}
+
+	void threadMgr::clear()
+	{
+		states_.clear();
+		slots_.clear();
+		free_.clear();
+	}
+}
@@ -421,6 +421,7 @@ static int luaB_pcall (lua_State *L) {
   luaL_checkany(L, 1);
   lua_pushboolean(L, 1);  /* first result if no errors */
   lua_insert(L, 1);  /* put it in place */
+  lua_markpcall(L, LUA_EXCEPTION_PCALL);
   status = lua_pcallk(L, lua_gettop(L) - 2, LUA_MULTRET, 0, 0, finishpcall);
   return finishpcall(L, status, 0);
 }
@@ -438,6 +439,7 @@ static int luaB_xpcall (lua_State *L) {
   lua_pushboolean(L, 1);  /* first result */
   lua_pushvalue(L, 1);  /* function */
   lua_rotate(L, 3, 2);  /* move them below function's arguments */
+  lua_markpcall(L, LUA_EXCEPTION_XPCALL);
   status = lua_pcallk(L, n - 2, LUA_MULTRET, 2, 2, finishpcall);
   return finishpcall(L, status, 2);
 }
@@ -637,9 +637,28 @@ const char *luaG_addinfo (lua_State *L, const char *msg, TString *src,
 }
 
 
+/*
+** Kind of the nearest protected call, found from the marks left on the
+** calling functions; errors that reach the bottom of the thread are
+** caught by 'lua_resume' or by the 'lua_pcall' that started it.
+*/
+static int pcallkind (lua_State *L) {
+  CallInfo *ci;
+  for (ci = L->ci; ci != &L->base_ci; ci = ci->previous) {
+    if (ci->callstatus & CIST_PCALL)
+      return LUA_EXCEPTION_PCALL;
+    if (ci->callstatus & CIST_XPCALL)
+      return LUA_EXCEPTION_XPCALL;
+    if (ci->callstatus & (CIST_PCALLER | CIST_YPCALL | CIST_FIN))
+      return LUA_EXCEPTION_LUAPCALL;
+  }
+  return LUA_EXCEPTION_LUAPCALL;
+}
+
+
 l_noret luaG_errormsg (lua_State *L) {
   if (L->hookmask & LUA_MASKEXCEPTION)
-    luaD_hook(L, LUA_HOOKEXCEPTION, -1);
+    luaD_hook(L, LUA_HOOKEXCEPTION, pcallkind(L));
   if (L->errfunc != 0) {  /* is there an error handling function? */
     StkId errfunc = restorestack(L, L->errfunc);
     setobjs2s(L, L->top, L->top - 1);  /* move argument */
@@ -706,3 +725,8 @@ lua_Integer lua_getprotohash(lua_State *L, int idx) {
 	c = (const LClosure *)lua_topointer(L, idx);
 	return c->p ? (lua_Integer)c->p ^ (lua_Integer)c->p->code : 0;
 }
+
+/* called by 'pcall' and 'xpcall' right before 'lua_pcallk' */
+void lua_markpcall(lua_State *L, int kind) {
+	L->ci->callstatus |= (kind == LUA_EXCEPTION_XPCALL) ? CIST_XPCALL : CIST_PCALL;
+}
@@ -105,6 +105,9 @@ typedef struct CallInfo {
 #define CIST_HOOKYIELD	(1<<6)	/* last hook called yielded */
 #define CIST_LEQ	(1<<7)  /* using __lt for __le */
 #define CIST_FIN	(1<<8)  /* call is running a finalizer */
+#define CIST_PCALLER	(1<<9)	/* C function inside a non-yieldable lua_pcall */
+#define CIST_PCALL	(1<<10)	/* call is running 'pcall' */
+#define CIST_XPCALL	(1<<11)	/* call is running 'xpcall' */
 
 #define isLua(ci)	((ci)->callstatus & CIST_LUA)
 
@@ -416,6 +416,14 @@ LUA_API void      (lua_setallocf) (lua_State *L, lua_Alloc f, void *ud);
 #define LUA_MASKCOUNT	(1 << LUA_HOOKCOUNT)
 #define LUA_MASKEXCEPTION	(1 << LUA_HOOKEXCEPTION)
 
+/*
+** 'currentline' of a LUA_HOOKEXCEPTION event: the kind of the nearest
+** protected call that will catch the error
+*/
+#define LUA_EXCEPTION_LUAPCALL	0	/* lua_pcall from C, or a coroutine */
+#define LUA_EXCEPTION_PCALL	1
+#define LUA_EXCEPTION_XPCALL	2
+
 typedef struct lua_Debug lua_Debug;  /* activation record */
 
 
@@ -440,6 +448,7 @@ LUA_API int (lua_gethookmask) (lua_State *L);
 LUA_API int (lua_gethookcount) (lua_State *L);
 
 LUA_API lua_Integer (lua_getprotohash)(lua_State *L, int idx);
+LUA_API void (lua_markpcall)(lua_State *L, int kind);
 
 
 struct lua_Debug {
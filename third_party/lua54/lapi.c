@@ -999,8 +999,11 @@ LUA_API int lua_pcallk (lua_State *L, int nargs, int nresults, int errfunc,
   }
   c.func = L->top - (nargs+1);  /* function to be called */
   if (k == NULL || L->nny > 0) {  /* no continuation or no yieldable? */
+    CallInfo *ci = L->ci;
     c.nresults = nresults;  /* do a 'conventional' protected call */
+    ci->callstatus |= CIST_PCALLER;  /* for the exception hook */
     status = luaD_pcall(L, f_call, &c, savestack(L, c.func), func);
+    ci->callstatus &= ~CIST_PCALLER;
   }
   else {  /* prepare continuation (call is already protected by 'resume') */
     CallInfo *ci = L->ci;
@@ -125,6 +125,9 @@ typedef struct CallInfo {
 #define CIST_LEQ	(1<<6)  /* using __lt for __le */
 #define CIST_FIN	(1<<7)  /* call is running a finalizer */
 #define CIST_TRAN	(1<<8)	/* 'ci' has transfer information */
+#define CIST_PCALLER	(1<<9)	/* C function inside a non-yieldable lua_pcall */
+#define CIST_PCALL	(1<<10)	/* call is running 'pcall' */
+#define CIST_XPCALL	(1<<11)	/* call is running 'xpcall' */
 
 /* active function is a Lua function */
 #define isLua(ci)	(!((ci)->callstatus & CIST_C))